@@ -0,0 +1,240 @@
+#include "Checkpointer.hpp"
+#include "Hash.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CKPT_MAGIC[8] = "MCDPCKP";
+constexpr uint32_t CKPT_VERSION = 1;
+constexpr uint64_t TRAILER_MAGIC = 0x444e45504b43444dULL; // "MDCKPEND"
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunk_shift;
+    uint64_t sequence;
+    uint64_t capacity;
+    uint64_t num_chunks;
+    uint32_t num_regions;
+    uint32_t full;                  // Starts a new image instead of patching the one before it
+    uint64_t region_offsets[MemoryArena::max_regions()];
+};
+
+// After the header, num_chunks records of (uint64_t chunk index, chunk bytes)
+struct SegmentTrailer {
+    uint64_t magic;
+    uint64_t sequence;
+    uint64_t hash;                  // Over every record, so a torn or flipped chunk gets caught
+};
+
+double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool write_all(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0) return false;
+        while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+// Calls f(chunk) for every chunk a segment carries. Full ones take everything allocated, deltas the dirty bits
+template <typename F>
+void for_each_chunk(const MemoryArena& arena, const std::vector<uint64_t>& bits, bool full, F f) {
+    int shift = arena.chunk_bits();
+    if (full) {
+        for (int r = 0; r < arena.region_count(); r++) {
+            size_t start = arena.region_start(r), end = arena.region_offset(r);
+            if (end == start) continue;
+            for (size_t c = start >> shift; c <= (end - 1) >> shift; c++) f(c);
+        }
+        return;
+    }
+    for (size_t w = 0; w < bits.size(); w++)
+        for (uint64_t word = bits[w]; word; word &= word - 1)
+            f(w * 64 + __builtin_ctzll(word));
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(MemoryArena& arena, const std::string& path, const CheckpointOptions& options)
+    : arena(arena), path(path), options(options) {
+    // Chunks can't be bigger than the 2MB the arena rounds its capacity to, or the last one would run off the end
+    if (this->options.chunk_shift > 21) this->options.chunk_shift = 21;
+    if (!arena.tracking_dirty()) arena.track_dirty(this->options.chunk_shift);
+    snapshot_bits.resize(arena.dirty_word_count());
+}
+
+Checkpointer::~Checkpointer() {
+    wait();
+}
+
+bool Checkpointer::begin(bool force_full) {
+    if (busy()) return false;
+
+    double start = now_ms();
+    bool full = need_full || force_full || log_bytes > options.compact_ratio * arena.used();
+    arena.take_dirty(snapshot_bits.data()); // A full image covers these too
+
+    SegmentHeader header{};
+    std::memcpy(header.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+    header.version = CKPT_VERSION;
+    header.chunk_shift = arena.chunk_bits();
+    header.sequence = ++sequence;
+    header.capacity = arena.get_capacity();
+    header.num_regions = arena.region_count();
+    header.full = full;
+    arena.save_offsets(header.region_offsets);
+    for_each_chunk(arena, snapshot_bits, full, [&](size_t) { header.num_chunks++; });
+
+    size_t chunk_bytes = size_t(1) << header.chunk_shift;
+    uint64_t segment_bytes = sizeof(header) + header.num_chunks * (sizeof(uint64_t) + chunk_bytes) + sizeof(SegmentTrailer);
+
+    // Full images go to a temp file and get renamed over the log, so there's always one whole log on disk
+    std::string tmp_path = path + ".tmp";
+    const char* target = full ? tmp_path.c_str() : path.c_str();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        need_full = true; // The dirty bits are gone, only a full image is safe now
+        return false;
+    }
+
+    if (pid == 0) {
+        // Child. It only has this thread and a copy on write image, so stick to raw syscalls and no allocation
+        int flags = O_WRONLY | O_CREAT | (full ? O_TRUNC : O_APPEND);
+        int fd = open(target, flags, 0644);
+        if (fd < 0) _exit(1);
+
+        iovec head{&header, sizeof(header)};
+        bool ok = write_all(fd, &head, 1);
+        uint64_t hash = 0;
+        for_each_chunk(arena, snapshot_bits, full, [&](size_t c) {
+            if (!ok) return;
+            uint64_t index = c;
+            std::byte* data = arena.base() + (c << header.chunk_shift);
+            hash = mix64(hash ^ hash_bytes(data, chunk_bytes, index));
+            iovec record[2] = {{&index, sizeof(index)}, {data, chunk_bytes}};
+            ok = write_all(fd, record, 2);
+        });
+
+        SegmentTrailer trailer{TRAILER_MAGIC, header.sequence, hash};
+        iovec tail{&trailer, sizeof(trailer)};
+        ok = ok && write_all(fd, &tail, 1) && fdatasync(fd) == 0;
+        ok = (close(fd) == 0) && ok;
+        if (ok && full) ok = rename(target, path.c_str()) == 0;
+        _exit(ok ? 0 : 1);
+    }
+
+    writer = pid;
+    started_ms = start;
+    log_bytes = full ? segment_bytes : log_bytes + segment_bytes;
+    need_full = false;
+
+    stats = CheckpointStats();
+    stats.sequence = header.sequence;
+    stats.chunks = header.num_chunks;
+    stats.bytes = segment_bytes;
+    stats.full = full;
+    stats.pause_ms = now_ms() - start;
+    return true;
+}
+
+bool Checkpointer::reap(bool block) {
+    int status = 0;
+    pid_t done = waitpid(writer, &status, block ? 0 : WNOHANG);
+    if (done == 0) return false; // Still writing
+
+    last_ok = done == writer && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!last_ok) need_full = true; // A delta on top of a missing segment would restore garbage
+    stats.write_ms = now_ms() - started_ms;
+    writer = -1;
+    return true;
+}
+
+bool Checkpointer::busy() {
+    return writer > 0 && !reap(false);
+}
+
+bool Checkpointer::wait() {
+    if (writer > 0) reap(true);
+    return last_ok;
+}
+
+bool Checkpointer::restore(const std::string& path, MemoryArena& arena) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    // First pass reads every segment through a scratch buffer and checks its hash, and finds where the last one
+    // that's whole and intact ends. A torn write at the end, or a segment that doesn't hash right, stops it there,
+    // so nothing of either gets applied, half or otherwise
+    off_t valid_end = 0;
+    SegmentHeader header;
+    SegmentHeader last;             // Last verified segment, its offsets are where allocation picks back up
+    SegmentTrailer trailer;
+    std::vector<std::byte> scratch;
+    while (std::fread(&header, sizeof(header), 1, f) == 1) {
+        bool ok = std::memcmp(header.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC)) == 0
+               && header.version == CKPT_VERSION
+               && header.capacity == arena.get_capacity()
+               && header.num_regions == static_cast<uint32_t>(arena.region_count())
+               && header.chunk_shift <= 21;
+        if (!ok) break;
+
+        size_t chunk_bytes = size_t(1) << header.chunk_shift;
+        uint64_t max_chunk = arena.get_capacity() >> header.chunk_shift;
+        scratch.resize(chunk_bytes);
+        uint64_t hash = 0;
+        for (uint64_t i = 0; ok && i < header.num_chunks; i++) {
+            uint64_t index;
+            ok = std::fread(&index, sizeof(index), 1, f) == 1 && index < max_chunk
+              && std::fread(scratch.data(), 1, chunk_bytes, f) == chunk_bytes;
+            if (ok) hash = mix64(hash ^ hash_bytes(scratch.data(), chunk_bytes, index));
+        }
+        if (!ok || std::fread(&trailer, sizeof(trailer), 1, f) != 1 || trailer.magic != TRAILER_MAGIC
+            || trailer.sequence != header.sequence || trailer.hash != hash)
+            break;
+        valid_end = ftello(f);
+        last = header;
+    }
+    if (valid_end == 0) {
+        std::fclose(f);
+        return false;
+    }
+
+    // Second pass reads the verified segments' chunks straight into place
+    std::fseek(f, 0, SEEK_SET);
+    bool ok = true;
+    while (ok && ftello(f) < valid_end) {
+        ok = std::fread(&header, sizeof(header), 1, f) == 1;
+        size_t chunk_bytes = size_t(1) << header.chunk_shift;
+        uint64_t max_chunk = arena.get_capacity() >> header.chunk_shift;
+        for (uint64_t i = 0; ok && i < header.num_chunks; i++) {
+            uint64_t index;
+            ok = std::fread(&index, sizeof(index), 1, f) == 1 && index < max_chunk
+              && std::fread(arena.base() + (index << header.chunk_shift), 1, chunk_bytes, f) == chunk_bytes;
+        }
+        ok = ok && std::fread(&trailer, sizeof(trailer), 1, f) == 1;
+    }
+    std::fclose(f);
+
+    if (ok) arena.restore_offsets(last.region_offsets);
+    return ok;
+}
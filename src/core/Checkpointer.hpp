@@ -0,0 +1,64 @@
+#pragma once
+#include "MemoryArena.hpp"
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// Incremental arena checkpoints as an append-only delta log. Each segment holds the chunks written since the
+// previous one plus the allocator offsets, and ends with a trailer that marks it complete.
+// The write happens in a fork()ed child, so the copy on write image is the snapshot and the workers only
+// stop for the fork itself. Every so often the log gets rewritten as one full segment so it doesn't grow forever
+struct CheckpointOptions {
+    int chunk_shift = 16;       // 64KB chunks. Smaller tracks in place Q updates tighter, bigger means fewer records
+    double compact_ratio = 2.0; // Rewrite the log as a full image once it's this many times the arena's used bytes
+};
+
+struct CheckpointStats {
+    uint64_t sequence = 0;
+    uint64_t chunks = 0;
+    uint64_t bytes = 0;
+    bool full = false;
+    double pause_ms = 0.0;      // Workers have to be stopped for this long
+    double write_ms = 0.0;      // Fork to writer exit, filled in once it's reaped
+};
+
+class Checkpointer {
+    MemoryArena& arena;
+    std::string path;
+    CheckpointOptions options;
+
+    std::vector<uint64_t> snapshot_bits; // Filled right before the fork, the child reads its copy
+    pid_t writer = -1;
+    uint64_t sequence = 0;
+    uint64_t log_bytes = 0;
+    bool need_full = true;              // First one, or the last write failed and its dirty bits are gone
+    bool last_ok = true;
+    CheckpointStats stats;
+    double started_ms = 0.0;
+
+    bool reap(bool block);
+
+public:
+    Checkpointer(MemoryArena& arena, const std::string& path, const CheckpointOptions& options = CheckpointOptions());
+    ~Checkpointer();
+
+    /**
+     * begin - Starts a checkpoint in the background, call it with every worker stopped
+     * @returns false if the previous one is still being written, the dirty chunks just carry over to the next
+     */
+    bool begin(bool force_full = false);
+
+    bool busy();        // Reaps a finished writer without blocking
+    bool wait();        // Blocks for the writer, true if the last checkpoint made it to disk
+
+    const CheckpointStats& last_stats() const { return stats; }
+
+    /**
+     * restore - Replays every complete segment of a log into an arena of at least the same size
+     * @returns false on a missing log, or one without a single whole segment. A torn or corrupt segment is
+     *          skipped with everything after it, nothing of it gets applied, so the arena comes back as of the last good one
+     */
+    static bool restore(const std::string& path, MemoryArena& arena);
+};
@@ -0,0 +1,99 @@
+#include "Generations.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+std::atomic<uint64_t> next_generations_id{1}; // 0 marks a thread that hasn't got a chunk yet
+
+} // namespace
+
+Generations::Generations(MemoryArena& arena, size_t chunk_bytes)
+    : arena(arena), chunk_bytes(chunk_bytes), chunk_shift(__builtin_ctzll(chunk_bytes)),
+      id(next_generations_id.fetch_add(1)) {
+    if (chunk_bytes & (chunk_bytes - 1)) throw std::runtime_error("Generations chunk size has to be a power of two");
+    size_t chunks = (arena.get_capacity() >> chunk_shift) + 1;
+    chunk_generation.assign(chunks, UNTRACKED);
+    chunk_live = std::make_unique<std::atomic<uint32_t>[]>(chunks);
+    for (size_t c = 0; c < chunks; c++) chunk_live[c].store(0, std::memory_order_relaxed);
+}
+
+// Whatever's left of the old chunk is abandoned, same as the arena's slabs
+void Generations::refill(ThreadChunk& chunk) {
+    std::lock_guard<SpinLock> guard(lock);
+    size_t off;
+    if (!free_chunks.empty()) {
+        off = free_chunks.back();
+        free_chunks.pop_back();
+    } else {
+        off = arena.offset_of(arena.carve(chunk_bytes, chunk_bytes));
+    }
+    chunk_generation[off >> chunk_shift] = current_generation;
+    chunk_live[off >> chunk_shift].store(0, std::memory_order_relaxed);
+
+    chunk.owner = id;
+    chunk.generation = current_generation;
+    chunk.cursor = reinterpret_cast<uintptr_t>(arena.at<std::byte>(off));
+    chunk.end = chunk.cursor + chunk_bytes;
+    chunk.live = &chunk_live[off >> chunk_shift];
+}
+
+void Generations::release_chunk(size_t chunk) {
+    arena.release(arena.at<std::byte>(chunk << chunk_shift), chunk_bytes);
+    chunk_generation[chunk] = FREE;
+    chunk_live[chunk].store(0, std::memory_order_relaxed);
+    free_chunks.push_back(chunk << chunk_shift);
+}
+
+void Generations::free(const void* ptr, size_t bytes) {
+    size_t chunk = arena.offset_of(ptr) >> chunk_shift;
+    if (chunk >= chunk_generation.size() || chunk_generation[chunk] < 0) return; // Not from here, nothing to do
+    uint32_t left = chunk_live[chunk].fetch_sub(static_cast<uint32_t>(bytes), std::memory_order_relaxed) - static_cast<uint32_t>(bytes);
+    if (left == 0 && chunk_generation[chunk] != current_generation) {
+        std::lock_guard<SpinLock> guard(lock);
+        release_chunk(chunk);
+    }
+}
+
+int Generations::advance() {
+    std::lock_guard<SpinLock> guard(lock);
+    return ++current_generation;
+}
+
+int Generations::oldest() const {
+    int oldest = current_generation;
+    for (int32_t g : chunk_generation)
+        if (g >= 0 && g < oldest) oldest = g;
+    return oldest;
+}
+
+int Generations::generation_of(const void* ptr) const {
+    size_t chunk = arena.offset_of(ptr) >> chunk_shift;
+    if (chunk >= chunk_generation.size()) return -1;
+    int32_t g = chunk_generation[chunk];
+    return g >= 0 ? g : -1;
+}
+
+size_t Generations::release(int generation) {
+    std::lock_guard<SpinLock> guard(lock);
+    size_t freed = 0;
+    for (size_t c = 0; c < chunk_generation.size(); c++) {
+        if (chunk_generation[c] != generation) continue;
+        release_chunk(c);
+        freed += chunk_bytes;
+    }
+    return freed;
+}
+
+size_t Generations::bytes_in(int generation) const {
+    size_t bytes = 0;
+    for (int32_t g : chunk_generation)
+        if (g == generation) bytes += chunk_bytes;
+    return bytes;
+}
+
+size_t Generations::free_bytes() const {
+    return free_chunks.size() * chunk_bytes;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "MemoryArena.hpp"
+#include "SpinLock.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chunks of a MemoryArena grouped into generations, for data that gets thrown away wholesale. Threads bump
+// allocate in a chunk of their own from the current generation, like the arena's slabs. Releasing a generation
+// hands every one of its chunks back to the OS zeroed and puts them on a free list, without looking at what was in
+// them, so the caller has to have moved out or unlinked anything it still needs first.
+//
+// Blocks can also be freed one at a time. Each chunk counts its live bytes, and one that gets down to none goes
+// on the free list right away, whatever its generation. Nothing smaller than a chunk is ever reused.
+//
+// Chunks are chunk_bytes aligned in the arena, which is how any pointer maps back to its generation.
+// The bookkeeping lives in the process, not the arena: after a restore everything already there counts as
+// untracked and is never released
+class Generations {
+    struct ThreadChunk {
+        uint64_t owner = 0;
+        int generation = -1;
+        uintptr_t cursor = 0;
+        uintptr_t end = 0;
+        std::atomic<uint32_t>* live = nullptr;
+    };
+
+    static constexpr int32_t UNTRACKED = -1;
+    static constexpr int32_t FREE = -2;
+
+    MemoryArena& arena;
+    size_t chunk_bytes;
+    int chunk_shift;
+    uint64_t id;
+
+    SpinLock lock;                              // For everything below, only taken to switch chunks
+    std::vector<int32_t> chunk_generation;      // By arena offset >> chunk_shift
+    std::unique_ptr<std::atomic<uint32_t>[]> chunk_live; // Same, bytes allocated and not freed yet
+    std::vector<size_t> free_chunks;            // Arena offsets
+    int current_generation = 0;
+
+    // A few per thread, so allocators that take turns on one thread (a solver's nodes and its Q tables) don't keep
+    // abandoning each other's chunks. Two that land on the same one still work, they just refill more
+    static constexpr int THREAD_CHUNKS = 4;
+
+    ThreadChunk& thread_chunk() const {
+        static thread_local ThreadChunk chunks[THREAD_CHUNKS];
+        return chunks[id % THREAD_CHUNKS];
+    }
+
+    void refill(ThreadChunk& chunk);
+    void release_chunk(size_t chunk);
+
+public:
+    // chunk_bytes has to be a power of two, and bigger than anything that gets allocated
+    Generations(MemoryArena& arena, size_t chunk_bytes = 2 << 20);
+
+    Generations(const Generations&) = delete;
+    Generations& operator=(const Generations&) = delete;
+
+    // Zeroed, from the current generation. Safe from any thread, but not during advance() or release()
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        ThreadChunk& chunk = thread_chunk();
+        uintptr_t aligned_addr = (chunk.cursor + align - 1) & ~(align - 1);
+        if (chunk.owner != id || chunk.generation != current_generation || aligned_addr + bytes > chunk.end) {
+            refill(chunk);
+            aligned_addr = (chunk.cursor + align - 1) & ~(align - 1);
+        }
+        chunk.cursor = aligned_addr + bytes;
+        chunk.live->fetch_add(static_cast<uint32_t>(bytes), std::memory_order_relaxed);
+        arena.mark_dirty(reinterpret_cast<void*>(aligned_addr), bytes);
+        return reinterpret_cast<void*>(aligned_addr);
+    }
+
+    // Gives back a block from allocate() with the same bytes. Its chunk gets released once nothing in it is live,
+    // unless it's in the current generation, where threads may still be carving it. Only with allocating threads
+    // stopped
+    void free(const void* ptr, size_t bytes);
+
+    int current() const { return current_generation; }
+
+    // Starts a new generation, every thread moves on to a fresh chunk at its next allocation. Returns its number.
+    // Only with allocating threads stopped
+    int advance();
+
+    // Oldest generation that still has chunks, current() if none does
+    int oldest() const;
+
+    // -1 for anything not in one of this allocator's live chunks
+    int generation_of(const void* ptr) const;
+
+    // Frees all of a generation's chunks, returns how many bytes that was. Only with allocating threads stopped
+    size_t release(int generation);
+
+    size_t bytes_in(int generation) const;
+    size_t free_bytes() const;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// splitmix64 finalizer. Cheap, and avalanches well enough for table indexing
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Word at a time hash over a block of bytes. Runs 4 independent lanes so big blocks (the LUT file) don't
+// sit on one multiply dependency chain
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t lanes[4] = {seed ^ 0x9e3779b97f4a7c15ULL, seed + 1, seed + 2, seed + 3};
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t word;
+            std::memcpy(&word, p + i + l * 8, 8); // memcpy so unaligned input is fine
+            lanes[l] = mix64(lanes[l] ^ word);
+        }
+    }
+
+    uint64_t tail = 0;
+    for (size_t shift = 0; i < len; i++, shift += 8)
+        tail |= static_cast<uint64_t>(p[i]) << (shift & 63);
+
+    uint64_t h = mix64(lanes[0] ^ tail) ^ mix64(lanes[1] + len);
+    h = mix64(h ^ lanes[2]);
+    return mix64(h ^ lanes[3]);
+}
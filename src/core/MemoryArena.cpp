@@ -0,0 +1,271 @@
+#include "MemoryArena.hpp"
+#include "Numa.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t HUGE_PAGE = 2 << 20;
+
+constexpr char ARENA_MAGIC[8] = "MCDPARN";
+constexpr uint32_t ARENA_VERSION = 1;
+
+std::atomic<uint64_t> next_arena_id{1}; // 0 marks a thread that hasn't got a slab yet
+
+size_t round_up(size_t bytes, size_t to) {
+    return (bytes + to - 1) / to * to;
+}
+
+} // namespace
+
+MemoryArena::MemoryArena(uint64_t mb, const ArenaOptions& options)
+    : slabs(0), local_bytes(0), remote_bytes(0), id(next_arena_id.fetch_add(1)), slab_bytes(options.slab_bytes) {
+    capacity = round_up(mb * 1024ULL * 1024ULL, HUGE_PAGE);
+    static_assert(sizeof(Header) <= RESERVED_BYTES, "Arena header has to fit in the reserved bytes");
+    static_assert(std::atomic<size_t>::is_always_lock_free && sizeof(std::atomic<size_t>) == sizeof(uint64_t),
+                  "Shared arenas keep their offsets as atomics over the header");
+
+    if (options.file.empty())
+        map_anonymous(options);
+    else
+        map_file(options);
+
+    if (restored) {
+        // Same split as when it was written, or the saved offsets won't line up with the regions. A shared arena's
+        // offsets are the header's already
+        split_regions(header()->num_regions, false);
+        if (!shared)
+            for (int i = 0; i < num_regions; i++) regions[i].offset->store(header()->region_offsets[i]);
+        uint64_t bits = shared ? shared_word(header()->dirty_bits).load() : 0;
+        if (bits) adopt_dirty(bits); // Whoever made them is checkpointing, mark into them
+        return;
+    }
+
+    split_regions(options.numa ? std::min(numa_node_count(), MAX_REGIONS) : 1, true);
+    Header* h = header();
+    std::memcpy(h->magic, ARENA_MAGIC, sizeof(ARENA_MAGIC));
+    h->version = ARENA_VERSION;
+    h->capacity = capacity;
+    h->num_regions = num_regions;
+}
+
+void MemoryArena::map_anonymous(const ArenaOptions& options) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (options.no_reserve ? MAP_NORESERVE : 0);
+
+    mapping = MAP_FAILED;
+    if (options.huge_tlb) {
+        mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (mapping == MAP_FAILED)
+            fprintf(stderr, "MAP_HUGETLB failed (%s), falling back to normal pages\n", strerror(errno));
+        mapping_bytes = capacity;
+        base_ptr = static_cast<std::byte*>(mapping);
+        backing = "hugetlb";
+    }
+
+    if (mapping == MAP_FAILED) {
+        // Map an extra huge page of slack and start at the first 2MB boundary, so THP can back it from the start
+        mapping_bytes = capacity + HUGE_PAGE;
+        mapping = mmap(nullptr, mapping_bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(std::string("MemoryArena mmap failed: ") + strerror(errno));
+
+        uintptr_t aligned = round_up(reinterpret_cast<uintptr_t>(mapping), HUGE_PAGE);
+        base_ptr = reinterpret_cast<std::byte*>(aligned);
+        backing = "4k";
+        if (options.transparent_huge && madvise(base_ptr, capacity, MADV_HUGEPAGE) == 0)
+            backing = "thp";
+    }
+}
+
+// A new file gets sized sparse, so it reads as zeros like anonymous memory. An existing one has to have been
+// closed cleanly, then its header says how big it is and where allocation left off
+void MemoryArena::map_file(const ArenaOptions& options) {
+    int fd = open(options.file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::runtime_error("MemoryArena can't open " + options.file + ": " + strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("MemoryArena can't stat " + options.file + ": " + strerror(errno));
+    }
+    if (st.st_size > 0) {
+        Header saved;
+        bool ok = pread(fd, &saved, sizeof(saved), 0) == sizeof(saved)
+               && std::memcmp(saved.magic, ARENA_MAGIC, sizeof(ARENA_MAGIC)) == 0
+               && saved.version == ARENA_VERSION
+               && static_cast<uint64_t>(st.st_size) >= saved.capacity;
+        if (!ok) {
+            close(fd);
+            throw std::runtime_error(options.file + " isn't an arena file");
+        }
+        if (!saved.clean && !options.shared) {
+            close(fd);
+            throw std::runtime_error(options.file + " wasn't closed cleanly, restore from a checkpoint log instead");
+        }
+        capacity = saved.capacity;
+        restored = true;
+        attached_live = !saved.clean;
+    } else if (ftruncate(fd, capacity) != 0) {
+        close(fd);
+        throw std::runtime_error("MemoryArena can't size " + options.file + ": " + strerror(errno));
+    }
+
+    int flags = MAP_SHARED | (options.no_reserve ? MAP_NORESERVE : 0);
+    mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, flags, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::string("MemoryArena mmap failed: ") + strerror(errno));
+
+    mapping_bytes = capacity;
+    base_ptr = static_cast<std::byte*>(mapping);
+    backing = "file";
+    file_backed = true;
+    shared = options.shared;
+    if (shared) shared_word(header()->attached).fetch_add(1);
+    if (attached_live) return; // Unclean already, and others are writing to it
+
+    // Dirty until the next clean close. Synced now, so a crash from here on can't leave it looking clean
+    header()->clean = 0;
+    msync(base_ptr, RESERVED_BYTES, MS_SYNC);
+}
+
+// Nothing has been touched yet, so binding each region before first touch is all the placement needs.
+// fresh starts the offsets at the beginning of each region, otherwise they're whatever gets loaded after
+void MemoryArena::split_regions(int nodes, bool fresh) {
+    size_t region_bytes = capacity / nodes / HUGE_PAGE * HUGE_PAGE;
+    if (region_bytes == 0) nodes = 1; // Too small to split
+
+    for (int& r : region_of_node) r = -1;
+    num_regions = 0;
+    for (int n = 0; n < nodes; n++) {
+        Region& region = regions[num_regions++];
+        region.start = n * region_bytes;
+        region.end = n == nodes - 1 ? capacity : region.start + region_bytes;
+        region.offset = shared ? &shared_word(header()->region_offsets[n]) : &region.own_offset;
+        if (fresh) region.offset->store(n == 0 ? RESERVED_BYTES : region.start);
+        region.node = -1;
+        if (nodes == 1 || n >= numa_node_count()) continue; // Restored on a machine with fewer nodes, just unplaced
+        if (attached_live) continue;                        // Already placed by whoever made it
+
+        int node = numa_nodes()[n];
+        region.node = node;
+        region_of_node[node] = n;
+        numa_bind(base_ptr + region.start, region.end - region.start, node);
+    }
+}
+
+void MemoryArena::persist() {
+    Header* h = header();
+    if (!shared) save_offsets(h->region_offsets);
+    if (!file_backed) return;
+
+    msync(base_ptr, capacity, MS_SYNC);
+    h->clean = 1; // Only after the data is down, so a crash in between leaves it unclean
+    msync(base_ptr, RESERVED_BYTES, MS_SYNC);
+}
+
+void* MemoryArena::carve(size_t bytes, size_t align) {
+    int home = 0;
+    if (num_regions > 1) {
+        int node = numa_current_node();
+        if (node >= 0 && node < MAX_REGIONS && region_of_node[node] >= 0) home = region_of_node[node];
+    }
+
+    if (void* p = carve_in(regions[home], bytes, align)) {
+        local_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        mark_dirty(p, bytes);
+        return p;
+    }
+    // Home node is full, spill over to the next one with room
+    for (int i = 1; i < num_regions; i++) {
+        if (void* p = carve_in(regions[(home + i) % num_regions], bytes, align)) {
+            remote_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            mark_dirty(p, bytes);
+            return p;
+        }
+    }
+    throw std::runtime_error("MemoryArena Out of Memory");
+}
+
+void MemoryArena::release(void* ptr, size_t bytes) {
+    if (file_backed || madvise(ptr, bytes, MADV_DONTNEED) != 0) std::memset(ptr, 0, bytes);
+    mark_dirty(ptr, bytes);
+}
+
+size_t MemoryArena::used() const {
+    size_t total = 0;
+    for (int i = 0; i < num_regions; i++)
+        total += regions[i].offset->load(std::memory_order_relaxed) - regions[i].start;
+    return total;
+}
+
+MemoryArena::~MemoryArena() {
+    bool last = !shared || shared_word(header()->attached).fetch_sub(1) == 1;
+    if (file_backed && last) persist();
+    munmap(mapping, mapping_bytes);
+}
+
+// Whatever's left of the old slab is abandoned, it's at most a few objects' worth
+void MemoryArena::refill(ThreadSlab& slab) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(carve(slab_bytes, SLAB_ALIGN));
+    slab.arena_id = id;
+    slab.cursor = start;
+    slab.end = start + slab_bytes;
+    slabs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryArena::track_dirty(int shift) {
+    size_t chunks = (capacity + (size_t(1) << shift) - 1) >> shift;
+    size_t words = (chunks + 63) / 64;
+
+    if (shared) {
+        // Every process has to mark into the same bits. Another one may have set them up meanwhile, then this
+        // carve just goes unused
+        uint64_t bits = offset_of(carve(words * sizeof(uint64_t), 64)) | static_cast<uint64_t>(shift);
+        uint64_t expected = 0;
+        if (!shared_word(header()->dirty_bits).compare_exchange_strong(expected, bits)) {
+            adopt_dirty(expected);
+            return;
+        }
+        adopt_dirty(bits);
+    } else {
+        chunk_shift = shift;
+        dirty_words = words;
+        dirty_storage = std::make_unique<std::atomic<uint64_t>[]>(dirty_words);
+        for (size_t w = 0; w < dirty_words; w++) dirty_storage[w].store(0, std::memory_order_relaxed);
+        dirty = dirty_storage.get();
+    }
+
+    for (int i = 0; i < num_regions; i++)
+        mark_dirty(base_ptr + regions[i].start, regions[i].offset->load() - regions[i].start);
+}
+
+void MemoryArena::adopt_dirty(uint64_t packed) {
+    chunk_shift = static_cast<int>(packed & 63);
+    size_t chunks = (capacity + (size_t(1) << chunk_shift) - 1) >> chunk_shift;
+    dirty_words = (chunks + 63) / 64;
+    dirty = at<std::atomic<uint64_t>>(packed & ~uint64_t(63));
+}
+
+void MemoryArena::take_dirty(uint64_t* out) {
+    for (size_t w = 0; w < dirty_words; w++)
+        out[w] = dirty[w].exchange(0, std::memory_order_relaxed);
+}
+
+void MemoryArena::save_offsets(size_t* out) const {
+    for (int i = 0; i < num_regions; i++) out[i] = regions[i].offset->load();
+}
+
+void MemoryArena::restore_offsets(const size_t* offsets) {
+    for (int i = 0; i < num_regions; i++) regions[i].offset->store(offsets[i]);
+    id = next_arena_id.fetch_add(1); // Any thread's slab from before now points at restored data, so drop them all
+}
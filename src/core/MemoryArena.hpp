@@ -1,48 +1,204 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <memory> // For unique_ptr stuff
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <string>
 #include <utility> // For std::forward
-#include <mutex>
 
 #include "RelPtr.hpp"
 
+struct ArenaOptions {
+    bool no_reserve = true;         // MAP_NORESERVE, so a huge arena only costs the pages that get touched
+    bool huge_tlb = false;          // Explicit huge pages from the hugetlbfs pool, falls back to normal pages if it's empty
+    bool transparent_huge = true;   // madvise(MADV_HUGEPAGE) when not using huge_tlb
+    size_t slab_bytes = 2 << 20;    // What each thread grabs at a time, one huge page
+    bool numa = false;              // One region per node, threads allocate from the one they're running on
+    std::string file;               // MAP_SHARED over this file instead of anonymous memory. An existing file is reopened as is
+    bool shared = false;            // Other processes map the file at the same time, see below
+};
+
+// One big mapping handed out by bumping an offset. Threads carve private slabs out of it and allocate from
+// those with no synchronization, only grabbing a new slab touches the shared offset (one CAS).
+// In NUMA mode the mapping is split into a region per node, each with its own offset, and a thread carves
+// from its own node's region. It's still one mapping, so offsets work the same across regions.
+//
+// With a backing file the arena is the file. Everything in it links by offset and every lock word is valid at
+// zero, so reopening after a clean shutdown is just the mmap, pages come in lazily as they get touched.
+//
+// A shared arena is a file several processes have mapped at once: a /dev/shm file, or a memfd opened through
+// /proc/<pid>/fd/<n>. The allocation offsets and the dirty bits then live in the file instead of the process, so
+// every process carves from the same offsets and marks the same bits. Opening one that isn't clean attaches to it
+// live, it's taken to be in use by another process. The last process to close it marks it clean
 class MemoryArena {
-    std::unique_ptr<std::byte[]> base_ptr;
+public:
+    static constexpr int NUM_ROOTS = 16;
+
+private:
+    // Each thread's current slab. Tagged with the arena id instead of a pointer, so a new arena at the
+    // address of a dead one never reuses a stale slab
+    struct ThreadSlab {
+        uint64_t arena_id = 0;
+        uintptr_t cursor = 0;
+        uintptr_t end = 0;
+    };
+
+    // A node's slice of the mapping. Own cache line, since the offset gets CASed by every thread on the node
+    struct alignas(64) Region {
+        std::atomic<size_t> own_offset;
+        std::atomic<size_t>* offset;    // own_offset, or the header's copy in a shared arena
+        size_t start;
+        size_t end;
+        int node;
+    };
+
+    static constexpr size_t SLAB_ALIGN = 4096;
+    static constexpr int MAX_REGIONS = 64;
+
+    // Lives at offset 0, inside the reserved bytes. Only a file backed arena needs the offsets and clean flag,
+    // but the roots are how anything finds its structures again after a restore
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t clean;             // Set on a clean close, a file without it may have half done updates
+        uint64_t capacity;
+        uint32_t num_regions;
+        uint32_t reserved;
+        uint64_t region_offsets[MAX_REGIONS];  // Live in a shared arena, otherwise only written by persist()
+        uint64_t roots[NUM_ROOTS];
+        uint64_t dirty_bits;            // Offset of a shared arena's dirty bits with chunk_shift in the low 6, 0 until tracked
+        uint32_t attached;              // Processes that have a shared arena mapped
+        uint32_t reserved2;
+    };
+
+    Header* header() const { return reinterpret_cast<Header*>(base_ptr); }
+
+    // Header fields other processes update too. Lock free atomics are address free, so one over the mapping works
+    // across processes
+    template <typename T>
+    static std::atomic<T>& shared_word(T& field) { return *reinterpret_cast<std::atomic<T>*>(&field); }
+
+    std::byte* base_ptr;
     size_t capacity;
-    size_t offset;
-    std::mutex lock;
+    void* mapping;
+    size_t mapping_bytes;
+
+    Region regions[MAX_REGIONS];
+    int num_regions;
+    int region_of_node[MAX_REGIONS]; // -1 for nodes without one
+
+    std::atomic<uint64_t> slabs;
+    std::atomic<uint64_t> local_bytes;
+    std::atomic<uint64_t> remote_bytes;
+    uint64_t id;
+    size_t slab_bytes;
+    const char* backing;
+    bool file_backed = false;
+    bool restored = false;
+    bool shared = false;
+    bool attached_live = false;     // Shared and already in use when this process mapped it
+
+    // One bit per chunk written since the checkpointer last took them. Null until tracking is turned on. Points
+    // into the arena when it's shared, otherwise at dirty_storage
+    std::atomic<uint64_t>* dirty = nullptr;
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_storage;
+    size_t dirty_words = 0;
+    int chunk_shift = 0;
+
+    void* carve_in(Region& region, size_t bytes, size_t align) {
+        size_t curr = region.offset->load(std::memory_order_relaxed);
+        size_t start;
+        do {
+            start = (curr + align - 1) & ~(align - 1); // The base is page aligned, so aligning the offset is enough
+            if (start + bytes > region.end) return nullptr;
+        } while (!region.offset->compare_exchange_weak(curr, start + bytes, std::memory_order_relaxed));
+        return base_ptr + start;
+    }
 
-public:
-    MemoryArena(uint64_t mb) : offset(0) {
-        unsigned long long bytes = mb * 1024L * 1024L;
-        base_ptr = std::make_unique<std::byte[]>(bytes);
-        capacity = bytes;
+    void split_regions(int nodes, bool fresh);
+    void adopt_dirty(uint64_t packed);
+    void map_file(const ArenaOptions& options);
+    void map_anonymous(const ArenaOptions& options);
+
+    static ThreadSlab& thread_slab() {
+        static thread_local ThreadSlab slab;
+        return slab;
     }
 
-    // No destructor. Anything allocated needs to either be a POD or get destroyed before this
+    void refill(ThreadSlab& slab);
 
-    template <typename T, typename... Args>
-    RelPtr<T> create_object(Args&&... args) {
-        uintptr_t aligned_addr;
+public:
+    // Offset 0 is never handed out, so offset links can use it as null. The first page holds the header
+    static constexpr size_t RESERVED_BYTES = 4096;
+
+    MemoryArena(uint64_t mb, const ArenaOptions& options = ArenaOptions());
+    ~MemoryArena();
 
-        { // Critical section with the offset
-            std::lock_guard<std::mutex> guard(lock);
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
 
-            // Get current aligned address
-            uintptr_t curr_addr = reinterpret_cast<uintptr_t>(base_ptr.get()) + offset;
-            aligned_addr = (curr_addr + alignof(T) - 1) & ~(alignof(T) - 1);
+    // Nothing allocated gets destroyed. Anything allocated needs to either be a POD or get destroyed before this
 
-            size_t needed = aligned_addr - curr_addr + sizeof(T);
+    // Straight from a shared offset, the calling thread's node region first. For big blocks, and what slabs get
+    // cut from. Thread safe
+    void* carve(size_t bytes, size_t align);
 
-            if (offset + needed > capacity)
-                throw std::runtime_error("MemoryArena Out of Memory");
+    // Hands a page aligned range back to the OS and leaves it zeroed for whoever reuses it. Anonymous memory just
+    // drops the pages, a file has to be written over
+    void release(void* ptr, size_t bytes);
 
-            offset += needed;
+    // Memory is zeroed, which lock free structures rely on. Safe from any thread
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        if (bytes > slab_bytes / 4 || align > SLAB_ALIGN)
+            return carve(bytes, align); // Would mostly waste a slab
+
+        ThreadSlab& slab = thread_slab();
+        uintptr_t aligned_addr = (slab.cursor + align - 1) & ~(align - 1);
+        if (slab.arena_id != id || aligned_addr + bytes > slab.end) {
+            refill(slab);
+            aligned_addr = (slab.cursor + align - 1) & ~(align - 1);
         }
+        slab.cursor = aligned_addr + bytes;
+        mark_dirty(reinterpret_cast<void*>(aligned_addr), bytes); // The slab may have been carved before the last checkpoint
+        return reinterpret_cast<void*>(aligned_addr);
+    }
+
+    // Anything written in place after allocation (V, Q, status, table slots) has to call this, or incremental
+    // checkpoints miss it. Almost always a single load of a bit that's already set
+    void mark_dirty(const void* ptr, size_t bytes) {
+        if (!dirty || bytes == 0) return;
+        size_t off = offset_of(ptr);
+        for (size_t c = off >> chunk_shift; c <= (off + bytes - 1) >> chunk_shift; c++) {
+            std::atomic<uint64_t>& word = dirty[c >> 6];
+            uint64_t bit = 1ULL << (c & 63);
+            if (!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
+        }
+    }
+
+    // Starts dirty tracking with 2^shift byte chunks. Everything allocated so far counts as dirty
+    void track_dirty(int shift);
 
-        T* t_ptr = new (reinterpret_cast<T*>(aligned_addr)) T(std::forward<Args>(args)...);
+    // Moves the dirty bits into out (dirty_word_count() words) and clears them. Only with writers stopped
+    void take_dirty(uint64_t* out);
+
+    bool tracking_dirty() const { return dirty != nullptr; }
+    size_t dirty_word_count() const { return dirty_words; }
+    int chunk_bits() const { return chunk_shift; }
+
+    // Allocator state, so a restored image can carry on where the checkpoint left off
+    void save_offsets(size_t* out) const;
+    void restore_offsets(const size_t* offsets);
+
+    // Where region i's allocations start and currently end
+    size_t region_start(int i) const { return regions[i].start; }
+    size_t region_offset(int i) const { return regions[i].offset->load(std::memory_order_relaxed); }
+
+    template <typename T, typename... Args>
+    RelPtr<T> create_object(Args&&... args) {
+        T* t_ptr = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
 
         RelPtr<T> rel_ptr;
         rel_ptr = t_ptr;
@@ -51,28 +207,48 @@ public:
 
     template <typename T>
     RelPtr<T> malloc_raw(size_t count) {
-        uintptr_t aligned_addr;
+        RelPtr<T> rel_ptr;
+        rel_ptr = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        return rel_ptr;
+    }
 
-        { // Critical section with the offset
-            std::lock_guard<std::mutex> guard(lock);
+    uint64_t offset_of(const void* ptr) const {
+        return reinterpret_cast<const std::byte*>(ptr) - base_ptr;
+    }
 
-            uintptr_t curr_addr = reinterpret_cast<uintptr_t>(base_ptr.get()) + offset;
-            aligned_addr = (curr_addr + alignof(T) - 1) & ~(alignof(T) - 1);
+    template <typename T>
+    T* at(uint64_t off) const {
+        return reinterpret_cast<T*>(base_ptr + off);
+    }
 
-            size_t needed = aligned_addr - curr_addr + (count * sizeof(T));
+    size_t used() const; // Includes the unused tails of live slabs
+    size_t get_capacity() const { return capacity; }
+    uint64_t slab_count() const { return slabs.load(std::memory_order_relaxed); }
+    const char* page_backing() const { return backing; } // "hugetlb", "thp" or "4k"
+    int region_count() const { return num_regions; }
 
-            if (offset + needed > capacity)
-                throw std::runtime_error("MemoryArena Out of Memory");
+    // Bytes carved from the carving thread's own node region vs. spilled to another one
+    uint64_t local_carved() const { return local_bytes.load(std::memory_order_relaxed); }
+    uint64_t remote_carved() const { return remote_bytes.load(std::memory_order_relaxed); }
 
-            offset += needed;
-        }
-        // Unlock, since new offset is set
-        lock.unlock();
+    std::byte* base() const { return base_ptr; }
 
-        RelPtr<T> rel_ptr;
-        rel_ptr = reinterpret_cast<T*>(aligned_addr);
-        return rel_ptr;
+    // Named offsets for top level structures, kept in the header so they survive a restore
+    uint64_t get_root(int i) const { return header()->roots[i]; }
+    void set_root(int i, uint64_t off) {
+        header()->roots[i] = off;
+        mark_dirty(&header()->roots[i], sizeof(uint64_t));
     }
 
-    // Leaving checkpointing as serializiation within each object, run from the global
+    bool is_file_backed() const { return file_backed; }
+    bool was_restored() const { return restored; } // Reopened an existing file, roots and allocations are live
+    bool is_shared() const { return shared; }
+    bool was_attached() const { return attached_live; } // Another process had it open, everything in it is live
+
+    // Writes the allocator state and every dirty page back to the file and marks it clean. Workers have to be
+    // stopped, and since clean only means something at shutdown, the destructor is the usual caller. For a shared
+    // arena that's the last process to close it
+    void persist();
+
+    static constexpr int max_regions() { return MAX_REGIONS; }
 };
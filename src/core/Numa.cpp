@@ -0,0 +1,122 @@
+#include "Numa.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <omp.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int MAX_NODES = 64; // One word of node mask
+
+struct Topology {
+    std::vector<int> nodes;              // Node ids with memory
+    std::vector<std::vector<int>> cpus;  // Indexed by node id
+};
+
+// sysfs lists look like "0-3,8,10-11"
+std::vector<int> parse_list(const std::string& text) {
+    std::vector<int> out;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty() || part == "\n") continue;
+        size_t dash = part.find('-');
+        int lo = std::stoi(part.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+        for (int i = lo; i <= hi; i++) out.push_back(i);
+    }
+    return out;
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::string text;
+    std::getline(file, text);
+    return text;
+}
+
+const Topology& topology() {
+    static const Topology topo = [] {
+        Topology t;
+        t.nodes = parse_list(read_file("/sys/devices/system/node/has_memory"));
+        t.nodes.erase(std::remove_if(t.nodes.begin(), t.nodes.end(), [](int n) { return n >= MAX_NODES; }), t.nodes.end());
+        if (t.nodes.empty()) t.nodes = {0};
+
+        t.cpus.resize(MAX_NODES);
+        for (int node : t.nodes) {
+            t.cpus[node] = parse_list(read_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+        }
+        return t;
+    }();
+    return topo;
+}
+
+long mbind_call(void* addr, size_t bytes, int mode, uint64_t mask, unsigned flags) {
+    // The kernel reads maxnode - 1 bits, hence the + 1
+    return syscall(SYS_mbind, addr, bytes, mode, &mask, MAX_NODES + 1, flags);
+}
+
+} // namespace
+
+int numa_node_count() {
+    return static_cast<int>(topology().nodes.size());
+}
+
+const std::vector<int>& numa_nodes() {
+    return topology().nodes;
+}
+
+int numa_current_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+    return static_cast<int>(node);
+}
+
+const std::vector<int>& numa_node_cpus(int node) {
+    static const std::vector<int> none;
+    if (node < 0 || node >= MAX_NODES) return none;
+    return topology().cpus[node];
+}
+
+bool numa_bind(void* addr, size_t bytes, int node) {
+    if (numa_node_count() <= 1 || node < 0 || node >= MAX_NODES) return false;
+    return mbind_call(addr, bytes, MPOL_PREFERRED, 1ULL << node, 0) == 0; // Preferred, so a full node spills instead of failing
+}
+
+bool numa_interleave(void* addr, size_t bytes) {
+    if (numa_node_count() <= 1) return false;
+    uint64_t mask = 0;
+    for (int node : topology().nodes) mask |= 1ULL << node;
+    return mbind_call(addr, bytes, MPOL_INTERLEAVE, mask, MPOL_MF_MOVE) == 0;
+}
+
+bool numa_pin_thread(int index) {
+    const Topology& topo = topology();
+    int nodes = numa_node_count();
+    if (nodes <= 1) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : numa_node_cpus(topo.nodes[index % nodes])) CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+int numa_pin_omp_threads() {
+    int nodes = numa_node_count();
+    if (nodes <= 1) return 1;
+
+    std::atomic<int> failures(0);
+    #pragma omp parallel
+    {
+        if (!numa_pin_thread(omp_get_thread_num())) failures.fetch_add(1);
+    }
+    return failures.load() ? 1 : nodes;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Thin NUMA layer over the raw syscalls and sysfs, so there's no libnuma dependency. On a single node machine,
+// or when the kernel says no, every call quietly does nothing and the caller carries on with normal placement
+
+// Nodes that have memory, 1 when sysfs doesn't say
+int numa_node_count();
+
+// Their ids, which don't have to be 0..count-1
+const std::vector<int>& numa_nodes();
+
+// Node of the CPU the calling thread is on right now
+int numa_current_node();
+
+// CPUs on a node, empty if it doesn't exist
+const std::vector<int>& numa_node_cpus(int node);
+
+// Prefer node for the pages of a range (page aligned). Applies at first touch, so call it before writing
+bool numa_bind(void* addr, size_t bytes, int node);
+
+// Spread a range's pages round robin over every node, moving the ones already touched
+bool numa_interleave(void* addr, size_t bytes);
+
+// Pins the calling thread to the CPUs of node index % nodes. False if there's one node or the kernel says no
+bool numa_pin_thread(int index);
+
+// Pins OpenMP thread i of the default team to the CPUs of node i % nodes, so workers spread evenly across sockets.
+// Returns how many nodes the threads went over, 1 if it didn't pin anything
+int numa_pin_omp_threads();
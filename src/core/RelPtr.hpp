@@ -3,45 +3,105 @@
 #include <cstddef>
 #include <stdexcept>
 
-template <typename T>
+// Self relative pointer: stores where the target is relative to where the pointer itself lives, so anything
+// linked with them can be mapped at any address. Offset 0 is null, which also makes zeroed memory all nulls.
+//
+// Offset is the stored integer and Shift how many low bits it drops. With a 32 bit offset the distance is
+// measured from this pointer's own address rounded down to 2^Shift, and the target has to be 2^Shift aligned,
+// so the reach is +-2^(31 + Shift) bytes. Assigning something out of reach throws.
+//
+// Dereferencing doesn't check for null unless it's a debug build, it's on every step of every episode
+template <typename T, typename Offset = int64_t, int Shift = 0>
 class RelPtr {
-    int64_t offset;
+    static_assert(Shift == 0 || sizeof(Offset) < sizeof(intptr_t), "Only narrow offsets need scaling");
+
+    Offset offset;
+
+    static constexpr uintptr_t ALIGN_MASK = ~((uintptr_t(1) << Shift) - 1);
+
+    // The pointer itself is always aligned to its offset's size, so up to that the rounding is a no-op. Skipping
+    // it leaves base + offset * scale, which x86 folds into the load's addressing
+    uintptr_t origin() const {
+        if constexpr ((size_t(1) << Shift) <= alignof(Offset))
+            return reinterpret_cast<uintptr_t>(this);
+        else
+            return reinterpret_cast<uintptr_t>(this) & ALIGN_MASK;
+    }
+
+    T* resolve() const {
+        return reinterpret_cast<T*>(origin() + (static_cast<intptr_t>(offset) << Shift));
+    }
+
+    void check_null() const {
+#ifndef NDEBUG
+        if (offset == 0) throw std::runtime_error("Null RelPtr Access");
+#endif
+    }
 
 public:
     RelPtr() : offset(0) {
         // All get initialized as 0
     }
 
+    RelPtr(std::nullptr_t) : offset(0) {}
+
+    RelPtr(T* ptr) { *this = ptr; }
+
+    // The offset depends on where the pointer lives, so copying has to rebase it instead of copying the bits
+    RelPtr(const RelPtr& other) { *this = other.get(); }
+
+    RelPtr& operator=(const RelPtr& other) { return *this = other.get(); }
+
     RelPtr& operator=(T* ptr) {
-        offset = ptr ? reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(this) : 0; // Implicit ptr int to int64
+        if (!ptr) {
+            offset = 0;
+            return *this;
+        }
+        intptr_t diff = static_cast<intptr_t>(reinterpret_cast<uintptr_t>(ptr) - origin());
+        Offset scaled = static_cast<Offset>(diff >> Shift);
+        if ((static_cast<intptr_t>(scaled) << Shift) != diff || scaled == 0)
+            throw std::runtime_error("RelPtr target out of reach or misaligned");
+        offset = scaled;
         return *this;
     }
 
-    bool operator==(RelPtr other) {
-        return reinterpret_cast<uintptr_t>(this) + offset == reinterpret_cast<uintptr_t>(other) + other->offset;
+    // Null comes out as a select, not a branch
+    T* get() const {
+        T* ptr = resolve();
+        return offset ? ptr : nullptr;
     }
 
-    // I know it would be cleaner to reuse these, but I'm not sure if that would create a functional overhead
     T* operator->() const {
-        if (offset == 0) throw std::runtime_error("Null RelPtr Access");
-        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(this)+offset);
+        check_null();
+        return resolve();
     }
 
-    // Normal derefernece
     T& operator*() const {
-        if (offset == 0) throw std::runtime_error("Null RelPtr Access");
-        return *reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(this)+offset);
+        check_null();
+        return *resolve();
     }
 
-    // Allows array indexing
     T& operator[](std::ptrdiff_t index) const {
-        if (offset == 0) throw std::runtime_error("Null RelPtr Access");
-        T* base = *reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(this)+offset+index);
-        return base[index];
+        check_null();
+        return resolve()[index];
     }
 
+    // Compares targets, two pointers at different addresses hold different offsets for the same target
+    bool operator==(const RelPtr& other) const { return get() == other.get(); }
+    bool operator==(const T* ptr) const { return get() == ptr; }
+    bool operator==(std::nullptr_t) const { return offset == 0; }
+
     // Allows    if (rel_ptr)
     explicit operator bool() const {
         return offset != 0;
     }
 };
+
+namespace relptr_detail {
+constexpr int log2(size_t n) { return n <= 1 ? 0 : 1 + log2(n / 2); }
+}
+
+// Half the size of a RelPtr. Scaled by the target's alignment, so it reaches +-2^31 * alignof(T) bytes.
+// A struct pointing at its own type is still incomplete there, it has to pass Shift itself
+template <typename T, int Shift = relptr_detail::log2(alignof(T))>
+using RelPtr32 = RelPtr<T, int32_t, Shift>;
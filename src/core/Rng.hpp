@@ -0,0 +1,38 @@
+#pragma once
+#include "Hash.hpp"
+#include <cstdint>
+
+// xoshiro256** - small, fast, and each thread gets its own so nothing is shared between workers.
+// Seeded from (run seed, stream) through splitmix64, so a given seed replays the same sequence per thread
+class Rng {
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0) {
+        uint64_t x = seed ^ mix64(stream + 0x9e3779b97f4a7c15ULL);
+        for (auto& word : s) {
+            x += 0x9e3779b97f4a7c15ULL; // splitmix64 step
+            word = mix64(x);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // [0, 1) with 53 random bits
+    double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+    // [0, n) without a modulo, by taking the high half of a 64x64 multiply
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <immintrin.h>
+#include <unistd.h>
+
+// One word lock where zero means unlocked. Anything holding one can live in zeroed arena memory, and a restored
+// or freshly mapped arena needs no pass to init locks. Critical sections on nodes are a few stores, so spinning
+// beats parking. Works with std::lock_guard
+//
+// The word is the holder's pid, so when processes share an arena, a lock left held by one that died can be found
+// and broken
+class SpinLock {
+    std::atomic<uint32_t> word;
+
+    static uint32_t self() {
+        static const uint32_t pid = static_cast<uint32_t>(getpid());
+        return pid;
+    }
+
+public:
+    SpinLock() : word(0) {}
+
+    // CAS rather than exchange, a waiter mustn't overwrite whose lock it is
+    void lock() {
+        uint32_t expected = 0;
+        while (!word.compare_exchange_weak(expected, self(), std::memory_order_acquire, std::memory_order_relaxed)) {
+            while (word.load(std::memory_order_relaxed)) _mm_pause(); // Spin on a read so the line stays shared
+            expected = 0;
+        }
+    }
+
+    bool try_lock() {
+        uint32_t expected = 0;
+        return !word.load(std::memory_order_relaxed)
+            && word.compare_exchange_strong(expected, self(), std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock() { word.store(0, std::memory_order_release); }
+
+    uint32_t holder() const { return word.load(std::memory_order_relaxed); }
+
+    // Unlocks if pid still holds it. Only for a pid whose process is gone
+    bool break_held(uint32_t pid) {
+        uint32_t expected = pid;
+        return word.compare_exchange_strong(expected, 0, std::memory_order_release);
+    }
+};
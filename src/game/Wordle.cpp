@@ -1,19 +1,46 @@
 #include "Wordle.hpp"
 
-Wordle::Wordle() {
-    // TODO: Load files into vectors
-    answers.reserve(NUM_ANSWERS);
-    guesses.reserve(NUM_GUESSES);
-    pattern_lut.resize(NUM_GUESSES * NUM_ANSWERS); // Also inits to 0s
+#include <fstream>
+#include <stdexcept>
+
+Wordle::Wordle(const std::string& answers_path, const std::string& guesses_path) {
+    answers = load_words(answers_path);
+    guesses = load_words(guesses_path);
+
+    if (answers.size() != NUM_ANSWERS || guesses.size() != NUM_GUESSES)
+        throw std::runtime_error("Word list sizes don't match NUM_ANSWERS / NUM_GUESSES");
+
+    answer_letters = letter_masks(answers);
+    guess_letters = letter_masks(guesses);
 }
 
-void Wordle::build_lut() {
-    #pragma omp parallel for collapse(2)
-    for (int g = 0; g < NUM_GUESSES; ++g) {
-        for (int a = 0; a < NUM_ANSWERS; ++a) {
-            pattern_lut[g * NUM_ANSWERS + a] = compute_pattern(guesses[g], answers[a]); // Shouldn't get out of bounds
-        }
+std::vector<std::string> Wordle::load_words(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("Failed to open word list " + path);
+
+    std::vector<std::string> words;
+    std::string word;
+    while (file >> word) {
+        if (word.size() != 5) throw std::runtime_error("Bad word in " + path + ": " + word);
+        words.push_back(word);
     }
+    return words;
+}
+
+std::vector<uint32_t> Wordle::letter_masks(const std::vector<std::string>& words) {
+    std::vector<uint32_t> masks;
+    masks.reserve(words.size());
+    for (const std::string& word : words) {
+        uint32_t mask = 0;
+        for (char c : word) mask |= 1u << (c - 'a');
+        masks.push_back(mask);
+    }
+    return masks;
+}
+
+void Wordle::build_lut(const std::string& cache_path, bool interleave) {
+    pattern_lut.load_or_build(cache_path, guesses, answers);
+    if (interleave) pattern_lut.interleave_pages();
 }
 
 uint8_t Wordle::compute_pattern(const std::string& guess, const std::string& target) {
@@ -51,14 +78,13 @@ uint8_t Wordle::compute_pattern(const std::string& guess, const std::string& tar
 }
 
 void Wordle::apply_guess(const StateBitmap& current_state, StateBitmap& next_state, int action_index, int answer_index) const {
-    uint8_t target_pattern = get_pattern_lookup(action_index, answer_index);
+    const uint8_t* row = pattern_lut.guess_row(action_index);
+    uint8_t target_pattern = row[answer_index];
     next_state.reset();
 
-    // TODO: Apply bitmap SIMD optimization
-    for (int i = 0; i < NUM_ANSWERS; i++) {
-        if (current_state.test(i)) {
-            if (get_pattern_lookup(action_index, answer_index) == target_pattern)
-                next_state.set(i);
-        }
+    // Single child only. Anything that needs more than one child of a guess should use partition_state
+    for (int i : current_state) {
+        if (row[i] == target_pattern)
+            next_state.set(i);
     }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "GameTypes.hpp"
+#include "PatternLUT.hpp"
 #include <vector>
 #include <string>
 #include <array>
@@ -15,13 +16,21 @@ private:
     std::vector<std::string> answers;
     std::vector<std::string> guesses;
 
-    std::vector<uint8_t> pattern_lut;
+    PatternLUT pattern_lut;
+
+    // Bit c - 'a' set for every letter c in the word
+    std::vector<uint32_t> answer_letters;
+    std::vector<uint32_t> guess_letters;
+
+    static std::vector<std::string> load_words(const std::string& path);
+    static std::vector<uint32_t> letter_masks(const std::vector<std::string>& words);
 
 public:
-    Wordle();
+    Wordle(const std::string& answers_path = "data/answers.txt", const std::string& guesses_path = "data/guesses.txt");
  
-    // LUT orchestrator, uses compute_pattern
-    void build_lut();
+    // LUT orchestrator, uses compute_pattern. Loads from the cache file when it matches the word lists.
+    // interleave spreads its pages over the NUMA nodes
+    void build_lut(const std::string& cache_path = "data/pattern_lut.bin", bool interleave = false);
 
     // Actual number crunching for playing a Wordle guess
     static uint8_t compute_pattern(const std::string& guess, const std::string& target);
@@ -31,9 +40,16 @@ public:
 
     // Quick lookup for the private lut
     uint8_t get_pattern_lookup(int action_index, int answer_index) const {
-        return pattern_lut[action_index * NUM_ANSWERS + answer_index];
+        return pattern_lut.get(action_index, answer_index);
     }
 
+    const PatternLUT& get_lut() const { return pattern_lut; }
+
+    uint32_t get_answer_letters(int answer_index) const { return answer_letters[answer_index]; }
+    uint32_t get_guess_letters(int action_index) const { return guess_letters[action_index]; }
+
+    const std::string& get_guess(int action_index) const { return guesses[action_index]; }
+
     int get_num_answers() const {return answers.size(); }
     int get_num_guesses() const {return guesses.size(); }
 };
@@ -0,0 +1,282 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+// Fixed width bitmap for answer and action sets. Same method names as std::bitset so it drops in,
+// plus select, subset and a set bit iterator.
+//
+// The word array is padded out to whole cache lines and the padding is always kept zero, so the
+// SIMD loops below never need a tail. They're picked at runtime like the partition kernel, from what
+// the CPU has. Anything -march already turned on counts as there at compile time, so a native build
+// inlines straight through and a generic one makes one call per operation.
+struct BitmapIsa {
+    bool popcnt, bmi2, avx2, avx512f, avx512vpopcntdq;
+
+    static BitmapIsa detect() {
+        __builtin_cpu_init(); // Runs during static init, possibly before libgcc has done it
+        return {__builtin_cpu_supports("popcnt") != 0, __builtin_cpu_supports("bmi2") != 0,
+                __builtin_cpu_supports("avx2") != 0, __builtin_cpu_supports("avx512f") != 0,
+                __builtin_cpu_supports("avx512vpopcntdq") != 0};
+    }
+};
+
+// Looked up once at startup. Anything using a Bitmap before that sees all false and takes the plain loops
+inline const BitmapIsa bitmap_cpu = BitmapIsa::detect();
+
+namespace bitmap_isa {
+
+#if defined(__POPCNT__)
+inline bool popcnt() { return true; }
+#else
+inline bool popcnt() { return bitmap_cpu.popcnt; }
+#endif
+#if defined(__BMI2__)
+inline bool bmi2() { return true; }
+#else
+inline bool bmi2() { return bitmap_cpu.bmi2; }
+#endif
+#if defined(__AVX2__)
+inline bool avx2() { return true; }
+#else
+inline bool avx2() { return bitmap_cpu.avx2; }
+#endif
+#if defined(__AVX512F__)
+inline bool avx512f() { return true; }
+#else
+inline bool avx512f() { return bitmap_cpu.avx512f; }
+#endif
+#if defined(__AVX512VPOPCNTDQ__)
+inline bool avx512vpopcntdq() { return true; }
+#else
+inline bool avx512vpopcntdq() { return bitmap_cpu.avx512vpopcntdq; }
+#endif
+
+} // namespace bitmap_isa
+
+template <int Bits>
+class alignas(64) Bitmap {
+public:
+    static constexpr int NUM_WORDS = (Bits + 63) / 64;
+    static constexpr int PADDED_WORDS = (NUM_WORDS + 7) & ~7;
+
+private:
+    uint64_t words[PADDED_WORDS];
+
+    static constexpr uint64_t LAST_WORD_MASK = (Bits % 64 == 0) ? ~0ULL : ((1ULL << (Bits % 64)) - 1);
+
+public:
+    Bitmap() : words{} {}
+
+    // Walks set bits one word at a time with ctz, so empty words are one compare each
+    class Iterator {
+        const uint64_t* words;
+        int word_index;
+        uint64_t bits;
+
+        // Stops at NUM_WORDS with no bits left, which is exactly what end() is
+        void skip_empty() {
+            while (bits == 0 && word_index < NUM_WORDS - 1)
+                bits = words[++word_index];
+            if (bits == 0) word_index = NUM_WORDS;
+        }
+
+    public:
+        Iterator(const uint64_t* words, int word_index)
+            : words(words), word_index(word_index), bits(word_index < NUM_WORDS ? words[word_index] : 0) {
+            skip_empty();
+        }
+
+        int operator*() const { return word_index * 64 + __builtin_ctzll(bits); }
+
+        Iterator& operator++() {
+            bits &= bits - 1; // Drop the lowest set bit
+            skip_empty();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const { return word_index != other.word_index || bits != other.bits; }
+    };
+
+    Iterator begin() const { return Iterator(words, 0); }
+    Iterator end() const { return Iterator(words, NUM_WORDS); }
+
+    // --- Single bits, unchecked ---
+    bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(int i) { words[i >> 6] |= 1ULL << (i & 63); }
+    void reset(int i) { words[i >> 6] &= ~(1ULL << (i & 63)); }
+    void set(int i, bool value) { value ? set(i) : reset(i); }
+
+    // --- Whole map ---
+    void reset() {
+        for (int w = 0; w < PADDED_WORDS; w++) words[w] = 0;
+    }
+
+    void set() {
+        for (int w = 0; w < NUM_WORDS; w++) words[w] = ~0ULL;
+        words[NUM_WORDS - 1] = LAST_WORD_MASK;
+    }
+
+    static Bitmap full() {
+        Bitmap b;
+        b.set();
+        return b;
+    }
+
+    uint64_t word(int w) const { return words[w]; }
+    const uint64_t* data() const { return words; }
+    uint64_t* data() { return words; }
+
+    int count() const {
+        if (bitmap_isa::avx512vpopcntdq()) return count_avx512(words);
+        if (bitmap_isa::popcnt()) return count_popcnt(words);
+        return count_words(words);
+    }
+
+    bool any() const {
+        for (int w = 0; w < NUM_WORDS; w++)
+            if (words[w]) return true;
+        return false;
+    }
+
+    bool none() const { return !any(); }
+
+    // Index of the nth set bit (0 based), or -1 if there aren't that many
+    int select(int n) const {
+        // Rank scan with hardware popcnt, then PDEP inside the word. A 37 word scan beats keeping rank
+        // blocks up to date on every child bitmap we build
+        if (bitmap_isa::bmi2() && bitmap_isa::popcnt()) return select_bmi2(words, n);
+        return select_words(words, n);
+    }
+
+    static int select_in_word(uint64_t word, int n) {
+        if (bitmap_isa::bmi2()) return select_in_word_bmi2(word, n);
+        for (int i = 0; i < n; i++) word &= word - 1;
+        return __builtin_ctzll(word);
+    }
+
+    // --- Algebra ---
+    Bitmap& operator&=(const Bitmap& other) {
+        for (int w = 0; w < PADDED_WORDS; w++) words[w] &= other.words[w];
+        return *this;
+    }
+
+    Bitmap& operator|=(const Bitmap& other) {
+        for (int w = 0; w < PADDED_WORDS; w++) words[w] |= other.words[w];
+        return *this;
+    }
+
+    // this &= ~other
+    Bitmap& and_not(const Bitmap& other) {
+        for (int w = 0; w < PADDED_WORDS; w++) words[w] &= ~other.words[w];
+        return *this;
+    }
+
+    friend Bitmap operator&(Bitmap a, const Bitmap& b) { return a &= b; }
+    friend Bitmap operator|(Bitmap a, const Bitmap& b) { return a |= b; }
+
+    bool operator==(const Bitmap& other) const {
+        if (bitmap_isa::avx512f()) return equal_avx512(words, other.words);
+        if (bitmap_isa::avx2()) return equal_avx2(words, other.words);
+        uint64_t diff = 0;
+        for (int w = 0; w < NUM_WORDS; w++) diff |= words[w] ^ other.words[w];
+        return diff == 0;
+    }
+
+    bool operator!=(const Bitmap& other) const { return !(*this == other); }
+
+    // Every bit set here is also set in other
+    bool is_subset_of(const Bitmap& other) const {
+        if (bitmap_isa::avx512f()) return subset_avx512(words, other.words);
+        if (bitmap_isa::avx2()) return subset_avx2(words, other.words);
+        uint64_t extra = 0;
+        for (int w = 0; w < NUM_WORDS; w++) extra |= words[w] & ~other.words[w];
+        return extra == 0;
+    }
+
+private:
+    // --- Kernels for each ISA, the public methods above pick one ---
+
+    // Same loop twice, the target attribute is what lets the compiler use the popcnt instruction
+    static int count_words(const uint64_t* words) {
+        int total = 0;
+        for (int w = 0; w < NUM_WORDS; w++) total += __builtin_popcountll(words[w]);
+        return total;
+    }
+
+    __attribute__((target("popcnt")))
+    static int count_popcnt(const uint64_t* words) {
+        int total = 0;
+        for (int w = 0; w < NUM_WORDS; w++) total += __builtin_popcountll(words[w]);
+        return total;
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static int count_avx512(const uint64_t* words) {
+        __m512i total = _mm512_setzero_si512();
+        for (int w = 0; w < PADDED_WORDS; w += 8)
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_load_si512(words + w)));
+        return static_cast<int>(_mm512_reduce_add_epi64(total));
+    }
+
+    static int select_words(const uint64_t* words, int n) {
+        for (int w = 0; w < NUM_WORDS; w++) {
+            int pop = __builtin_popcountll(words[w]);
+            if (n < pop) return w * 64 + select_in_word(words[w], n);
+            n -= pop;
+        }
+        return -1;
+    }
+
+    __attribute__((target("popcnt,bmi2")))
+    static int select_bmi2(const uint64_t* words, int n) {
+        for (int w = 0; w < NUM_WORDS; w++) {
+            int pop = __builtin_popcountll(words[w]);
+            if (n < pop) return w * 64 + select_in_word_bmi2(words[w], n);
+            n -= pop;
+        }
+        return -1;
+    }
+
+    __attribute__((target("bmi2")))
+    static int select_in_word_bmi2(uint64_t word, int n) {
+        return __builtin_ctzll(_pdep_u64(1ULL << n, word)); // Deposits a single bit onto the nth set position
+    }
+
+    __attribute__((target("avx2")))
+    static bool equal_avx2(const uint64_t* a, const uint64_t* b) {
+        for (int w = 0; w < PADDED_WORDS; w += 4) {
+            __m256i diff = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(a + w)),
+                                            _mm256_load_si256(reinterpret_cast<const __m256i*>(b + w)));
+            if (!_mm256_testz_si256(diff, diff)) return false;
+        }
+        return true;
+    }
+
+    __attribute__((target("avx512f")))
+    static bool equal_avx512(const uint64_t* a, const uint64_t* b) {
+        for (int w = 0; w < PADDED_WORDS; w += 8)
+            if (_mm512_cmpneq_epi64_mask(_mm512_load_si512(a + w), _mm512_load_si512(b + w))) return false;
+        return true;
+    }
+
+    __attribute__((target("avx2")))
+    static bool subset_avx2(const uint64_t* words, const uint64_t* other) {
+        for (int w = 0; w < PADDED_WORDS; w += 4) {
+            // testc is 1 when (~other & this) == 0
+            if (!_mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(other + w)),
+                                    _mm256_load_si256(reinterpret_cast<const __m256i*>(words + w))))
+                return false;
+        }
+        return true;
+    }
+
+    __attribute__((target("avx512f")))
+    static bool subset_avx512(const uint64_t* words, const uint64_t* other) {
+        for (int w = 0; w < PADDED_WORDS; w += 8) {
+            __m512i extra = _mm512_andnot_si512(_mm512_load_si512(other + w), _mm512_load_si512(words + w));
+            if (_mm512_test_epi64_mask(extra, extra)) return false;
+        }
+        return true;
+    }
+};
@@ -1,15 +1,20 @@
 #pragma once
 #include <cstdint>
-#include <bitset>
+#include "Bitmap.hpp"
 
 constexpr int NUM_ANSWERS = 2315;
 constexpr int NUM_GUESSES = 12972;
 
-using StateBitmap = std::bitset<NUM_ANSWERS>;
-using ActionBitmap = std::bitset<NUM_GUESSES>;
+constexpr int NUM_PATTERNS = 243;      // 3^5 color combinations
+constexpr uint8_t PATTERN_SOLVED = 242; // All green, base 3 encoded 22222
+
+using StateBitmap = Bitmap<NUM_ANSWERS>;
+using ActionBitmap = Bitmap<NUM_GUESSES>;
 
 enum class NodeStatus : uint8_t {
     None = 0,
     Init = 1,
-    Sovled = 2
+    Solved = 2,
+    Evicted = 3,    // Had a Q table that got reclaimed, V is still what its parent's Q last saw. Expands like None
+    Remote = 4      // Another rank of a partitioned solve owns it, V is the last its owner reported. Never expanded here
 };
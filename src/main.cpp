@@ -0,0 +1,184 @@
+#include "Wordle.hpp"
+#include "Benchmarks.hpp"
+#include "Checkpointer.hpp"
+#include "Coordinator.hpp"
+#include "Partitioned.hpp"
+#include "Scheduler.hpp"
+#include "Numa.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <memory>
+#include <omp.h>
+#include <string>
+#include <unistd.h>
+
+struct CliOptions {
+    std::string answers_path = "data/answers.txt";
+    std::string guesses_path = "data/guesses.txt";
+    std::string lut_cache = "data/pattern_lut.bin"; // Empty disables the cache
+    std::string bench;                              // Run one micro benchmark and exit
+    bool numa = false;                              // Pin threads across nodes, interleave the LUT, per node arena regions
+    std::string shared_worker;                      // Attach to this shared arena as a worker and run until stopped
+    int rank = 0;                                   // Which worker, with shared_worker, or which rank, with partition_dir
+    std::string partition_dir;                      // Run one rank of a partitioned solve, sockets go here
+    int ranks = 1;
+    long episodes = 1000;                           // In all, or per rank with partition_dir
+    int threads = 0;                                // OpenMP's default when 0
+    long batch = 1000;                              // Episodes between budget checks, checkpoints and progress lines
+    uint64_t arena_mb = 8192;
+    uint64_t memory_mb = 0;                         // Bounded memory budget, 0 for none
+    std::string checkpoint;                         // Resume from this log if it's there, and keep checkpointing to it
+};
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "  --answers <path>     Answer word list (default data/answers.txt)\n"
+           "  --guesses <path>     Guess word list (default data/guesses.txt)\n"
+           "  --lut-cache <path>   Pattern LUT cache file, empty to disable\n"
+           "  --bench <name>       Run a kernel benchmark and exit\n"
+           "  --numa               NUMA placement: pinned threads, interleaved LUT, node local allocation\n"
+           "  --shared-worker <path>  Work on the shared arena at path, started by a coordinator\n"
+           "  --rank <n>           Worker slot with --shared-worker, or rank with --partition-dir (default 0)\n"
+           "  --partition-dir <dir>  Run one rank of a partitioned solve, every rank's socket goes in dir\n"
+           "  --ranks <n>          Ranks in the partitioned solve (default 1)\n"
+           "  --episodes <n>       Episodes to run, per rank with --partition-dir (default 1000)\n"
+           "  --threads <n>        Worker threads (default OpenMP's)\n"
+           "  --batch <n>          Episodes between budget checks, checkpoints and progress lines (default 1000)\n"
+           "  --arena-mb <n>       Arena size (default 8192)\n"
+           "  --memory-mb <n>      Memory budget, reclaims Q tables past it (default 0, unbounded)\n"
+           "  --checkpoint <path>  Resume from this checkpoint log if it exists, and checkpoint to it after every batch\n", prog);
+}
+
+static CliOptions parse_inputs(int argc, char** argv) {
+    CliOptions options;
+
+    static const option long_options[] = {
+        {"answers", required_argument, nullptr, 'a'},
+        {"guesses", required_argument, nullptr, 'g'},
+        {"lut-cache", required_argument, nullptr, 'l'},
+        {"bench", required_argument, nullptr, 'b'},
+        {"numa", no_argument, nullptr, 'n'},
+        {"shared-worker", required_argument, nullptr, 'w'},
+        {"rank", required_argument, nullptr, 'r'},
+        {"partition-dir", required_argument, nullptr, 'p'},
+        {"ranks", required_argument, nullptr, 'R'},
+        {"episodes", required_argument, nullptr, 'e'},
+        {"threads", required_argument, nullptr, 't'},
+        {"batch", required_argument, nullptr, 'B'},
+        {"arena-mb", required_argument, nullptr, 'A'},
+        {"memory-mb", required_argument, nullptr, 'M'},
+        {"checkpoint", required_argument, nullptr, 'c'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'a': options.answers_path = optarg; break;
+            case 'g': options.guesses_path = optarg; break;
+            case 'l': options.lut_cache = optarg; break;
+            case 'b': options.bench = optarg; break;
+            case 'n': options.numa = true; break;
+            case 'w': options.shared_worker = optarg; break;
+            case 'r': options.rank = atoi(optarg); break;
+            case 'p': options.partition_dir = optarg; break;
+            case 'R': options.ranks = atoi(optarg); break;
+            case 'e': options.episodes = atol(optarg); break;
+            case 't': options.threads = atoi(optarg); break;
+            case 'B': options.batch = atol(optarg); break;
+            case 'A': options.arena_mb = strtoull(optarg, nullptr, 10); break;
+            case 'M': options.memory_mb = strtoull(optarg, nullptr, 10); break;
+            case 'c': options.checkpoint = optarg; break;
+            case 'h': print_usage(argv[0]); exit(0);
+            default: print_usage(argv[0]); exit(1);
+        }
+    }
+    return options;
+}
+
+/**
+ * run_solver - The single process solve: batches of episodes on an EpisodeScheduler, with the memory budget enforced
+ *              and a checkpoint started after each one
+ * @returns Exit code for the process
+ */
+static int run_solver(const Wordle& wordle, const CliOptions& options) {
+    ArenaOptions arena_options;
+    arena_options.numa = options.numa;
+    MemoryArena arena(options.arena_mb, arena_options);
+    bool resumed = false;
+    if (!options.checkpoint.empty() && access(options.checkpoint.c_str(), F_OK) == 0) {
+        if (!Checkpointer::restore(options.checkpoint, arena)) {
+            fprintf(stderr, "Can't restore from %s\n", options.checkpoint.c_str());
+            return 1;
+        }
+        resumed = true;
+    }
+
+    SolverConfig config;
+    config.memory_budget_mb = options.memory_mb;
+    Solver solver(wordle, arena, config);
+    SchedulerConfig scheduling;
+    scheduling.threads = options.threads;
+    scheduling.numa = options.numa;
+    EpisodeScheduler scheduler(solver, scheduling);
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (!options.checkpoint.empty()) checkpointer = std::make_unique<Checkpointer>(arena, options.checkpoint);
+    if (resumed) printf("Resumed from %s, %lu nodes\n", options.checkpoint.c_str(), solver.get_table().size());
+
+    double start = omp_get_wtime();
+    long done = 0;
+    while (done < options.episodes) {
+        SchedulerStats stats = scheduler.run(std::min(options.batch, options.episodes - done));
+        done += stats.episodes;
+        for (const ReclaimStats& r : solver.enforce_budget())
+            printf("reclaimed generation %d: kept %d, summarized %d, evicted %d, %.1f -> %.1f MB\n", r.generation, r.kept,
+                   r.summarized, r.evicted, r.occupancy_before / 1048576.0, r.occupancy_after / 1048576.0);
+        if (checkpointer) checkpointer->begin(); // Still writing the last one is fine, the dirty chunks carry over
+
+        const StateNode* root = solver.get_root();
+        double rate = stats.ms > 0 ? stats.episodes / (stats.ms / 1000.0) : 0.0; // A tiny batch can finish inside a tick
+        printf("%ld episodes, %.0f per sec, %lu nodes, %.1f MB, root V %.4f\n", done, rate, solver.get_table().size(),
+               solver.occupancy() / 1048576.0, root->v());
+        if (options.numa) {
+            uint64_t local = arena.local_carved(), remote = arena.remote_carved();
+            printf("arena placement: %.1f MB local, %.1f MB remote, %.1f%% local\n", local / 1048576.0,
+                   remote / 1048576.0, local + remote ? 100.0 * local / (local + remote) : 100.0);
+        }
+    }
+    if (checkpointer && !(checkpointer->wait() && checkpointer->begin() && checkpointer->wait())) {
+        fprintf(stderr, "Final checkpoint to %s failed\n", options.checkpoint.c_str());
+        return 1;
+    }
+
+    const StateNode* root = solver.get_root();
+    int best = root->best_action();
+    printf("root V %.4f, best guess %s, %ld episodes in %.1f s\n", root->v(),
+           best >= 0 ? wordle.get_guess(root->actions->guesses()[best]).c_str() : "-", done, omp_get_wtime() - start);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    CliOptions options = parse_inputs(argc, argv);
+
+    if (options.numa) {
+        // Pin first, so everything touched from here on lands where its thread will run
+        int nodes = numa_pin_omp_threads();
+        printf("NUMA: %d node(s) with memory, threads pinned across %d\n", numa_node_count(), nodes);
+    }
+
+    Wordle wordle(options.answers_path, options.guesses_path);
+    wordle.build_lut(options.lut_cache, options.numa);
+
+    if (!options.bench.empty())
+        return run_benchmark(options.bench, wordle);
+    if (!options.shared_worker.empty())
+        return run_shared_worker(wordle, options.shared_worker, options.rank);
+    if (!options.partition_dir.empty())
+        return run_partition_rank(wordle, options.partition_dir, options.rank, options.ranks, options.episodes);
+
+    return run_solver(wordle, options);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Hash.hpp"
+#include "MemoryArena.hpp"
+#include "TranspositionTable.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// View of a guess index list that hasn't been interned yet
+struct ActionSpan {
+    const uint16_t* guesses;
+    int count;
+
+    uint64_t hash() const { return hash_bytes(guesses, count * sizeof(uint16_t), count); }
+};
+
+// Immutable list of guess indices in the arena, the guesses follow the header. 16 byte aligned so a node's
+// RelPtr32 to it reaches 32GB
+struct alignas(16) ActionList {
+    uint32_t count;
+
+    const uint16_t* guesses() const { return reinterpret_cast<const uint16_t*>(this + 1); }
+
+    bool matches(const ActionSpan& span) const {
+        return count == static_cast<uint32_t>(span.count)
+            && std::memcmp(guesses(), span.guesses, count * sizeof(uint16_t)) == 0;
+    }
+};
+
+// Content addressed pool of pruned action lists. Siblings mostly end up with the same useful guesses, so
+// identical lists get stored once and every node that has one points at the shared copy
+class ActionPool {
+    MemoryArena& arena;
+    TranspositionTable<ActionList> table;
+
+public:
+    // existing reattaches to a pool's table in a restored arena, see TranspositionTable
+    ActionPool(MemoryArena& arena, int size_exp, uint64_t existing = 0) : arena(arena), table(arena, size_exp, existing) {}
+
+    const ActionList* intern(const uint16_t* guesses, int count) {
+        ActionSpan span{guesses, count};
+        return table.find_or_insert(span.hash(), span, [&] {
+            void* mem = arena.allocate(sizeof(ActionList) + count * sizeof(uint16_t), alignof(ActionList));
+            ActionList* list = new (mem) ActionList{static_cast<uint32_t>(count)};
+            std::memcpy(list + 1, guesses, count * sizeof(uint16_t));
+            return list;
+        });
+    }
+
+    // See TranspositionTable::abandon
+    std::vector<uint64_t> unpublished() const { return table.unpublished(); }
+    uint64_t abandon(const std::vector<uint64_t>& claims) { return table.abandon(claims); }
+    uint64_t size() const { return table.size(); }
+    uint64_t offset() const { return table.offset(); }
+};
@@ -0,0 +1,1754 @@
+#include "Benchmarks.hpp"
+#include "Checkpointer.hpp"
+#include "Coordinator.hpp"
+#include "DpSolver.hpp"
+#include "Numa.hpp"
+#include "Partition.hpp"
+#include "Partitioned.hpp"
+#include "Scheduler.hpp"
+#include "Softmax.hpp"
+#include "Solver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <omp.h>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Random subset of the answers with exactly size members
+StateBitmap random_state(std::mt19937_64& rng, int size) {
+    std::vector<int> ids(NUM_ANSWERS);
+    for (int i = 0; i < NUM_ANSWERS; i++) ids[i] = i;
+    std::shuffle(ids.begin(), ids.end(), rng);
+
+    StateBitmap state;
+    for (int i = 0; i < size; i++) state.set(ids[i]);
+    return state;
+}
+
+int bench_partition(const Wordle& wordle) {
+    const PatternLUT& lut = wordle.get_lut();
+    std::mt19937_64 rng(42);
+    auto partition = std::make_unique<Partition>();
+
+    printf("%-8s %6s %6s %12s %12s %10s\n", "isa", "size", "form", "ns/call", "ns/answer", "check");
+    for (int size : {NUM_ANSWERS, 512, 64, 8}) {
+        // Same states in both key forms, the canonical one for their size is what nodes would hand the kernel
+        std::vector<StateBitmap> bitmaps;
+        std::vector<std::vector<uint16_t>> lists;
+        for (int i = 0; i < 32; i++) {
+            bitmaps.push_back(random_state(rng, size));
+            lists.emplace_back();
+            for (int a : bitmaps.back()) lists.back().push_back(a);
+        }
+        std::vector<StateKey> states;
+        for (int i = 0; i < 32; i++) {
+            states.push_back(StateKey::stores_compact(size) ? StateKey::from_list(lists[i].data(), size)
+                                                            : StateKey::from_bitmap(bitmaps[i], size));
+        }
+
+        std::vector<int> guesses(256);
+        for (int& g : guesses) g = rng() % NUM_GUESSES;
+
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (!kernel_isa_supported(isa)) continue;
+            set_kernel_isa(isa);
+
+            // Scale reps so each size runs for a comparable amount of work
+            int reps = std::max(1, 4096 / size);
+            uint64_t check = 0;
+            long calls = 0;
+
+            auto start = Clock::now();
+            for (int r = 0; r < reps; r++) {
+                for (const auto& state : states) {
+                    for (int g : guesses) {
+                        partition_state(lut, state, g, *partition);
+                        check += partition->num_buckets * 31 + partition->counts[partition->patterns[0]];
+                        calls++;
+                    }
+                }
+            }
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+            // check has to match across ISAs, otherwise a SIMD path is wrong
+            printf("%-8s %6d %6s %12.1f %12.2f %10lu\n", kernel_isa_name(isa), size, StateKey::stores_compact(size) ? "list" : "bitmap",
+                   ns / calls, ns / calls / size, check % 100000);
+        }
+    }
+    return 0;
+}
+
+// Runs op over a rotating set of inputs and returns ns per call. sink keeps the compiler from dropping it
+template <typename Op>
+double time_op(int calls, Op op) {
+    volatile long sink = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < calls; i++) sink = sink + op(i);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+}
+
+int bench_bitmap(const Wordle&) {
+    std::mt19937_64 rng(7);
+    constexpr int calls = 1 << 20;
+
+    printf("%6s %10s %10s %10s %10s %10s\n", "size", "count", "select", "subset", "equal", "iterate");
+    for (int size : {NUM_ANSWERS, 512, 64, 8}) {
+        std::vector<StateBitmap> states, supersets;
+        for (int i = 0; i < 64; i++) {
+            states.push_back(random_state(rng, size));
+            supersets.push_back(states.back() | random_state(rng, 16));
+        }
+        std::vector<int> ranks(calls);
+        for (int& r : ranks) r = rng() % size;
+
+        double count = time_op(calls, [&](int i) { return states[i & 63].count(); });
+        double select = time_op(calls, [&](int i) { return states[i & 63].select(ranks[i]); });
+        double subset = time_op(calls, [&](int i) { return (long)states[i & 63].is_subset_of(supersets[i & 63]); });
+        double equal = time_op(calls, [&](int i) { return (long)(states[i & 63] == states[(i + 1) & 63]); });
+        double iterate = time_op(calls / 64, [&](int i) {
+            long sum = 0;
+            for (int a : states[i & 63]) sum += a;
+            return sum;
+        });
+
+        printf("%6d %9.1fns %9.1fns %9.1fns %9.1fns %9.1fns\n", size, count, select, subset, equal, iterate);
+    }
+    return 0;
+}
+
+// Hammers get_or_create_node from every thread count up to OMP_NUM_THREADS. Half the lookups go to 64 hot
+// keys to mimic every episode starting at the root. Also checks every thread got the same node for a key
+// and that exactly one node was made per distinct key
+int bench_table(const Wordle& wordle) {
+    constexpr int NUM_KEYS = 1 << 15;
+    constexpr int HOT_KEYS = 64;
+    constexpr long OPS_PER_THREAD = 1 << 20;
+
+    std::mt19937_64 rng(11);
+    std::vector<StateBitmap> keys;
+    std::unordered_set<uint64_t> key_hashes; // Small random states repeat, and the distinct count check needs unique keys
+    while ((int)keys.size() < NUM_KEYS) {
+        StateBitmap key = random_state(rng, 1 + rng() % 64);
+        if (key_hashes.insert(StateKey::from_bitmap(key).hash()).second) keys.push_back(key);
+    }
+
+    int max_threads = omp_get_max_threads();
+    printf("%8s %12s %12s %10s %10s\n", "threads", "Mops/s", "ns/op", "nodes", "errors");
+
+    for (int threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+        MemoryArena arena(192);
+        SolverConfig config;
+        config.table_size_exp = 17;
+        config.action_pool_size_exp = 4;
+        Solver solver(wordle, arena, config);
+        std::vector<std::atomic<StateNode*>> seen(NUM_KEYS);
+        std::atomic<long> errors(0);
+
+        auto start = Clock::now();
+        #pragma omp parallel num_threads(threads)
+        {
+            std::mt19937_64 thread_rng(1000 + omp_get_thread_num());
+            for (long op = 0; op < OPS_PER_THREAD; op++) {
+                uint64_t r = thread_rng();
+                int k = (r & 1) ? (r >> 1) % HOT_KEYS : (r >> 1) % NUM_KEYS;
+
+                StateNode* node = solver.get_or_create_node(StateKey::from_bitmap(keys[k]));
+                StateNode* expected = nullptr;
+                if (!seen[k].compare_exchange_strong(expected, node) && expected != node)
+                    errors.fetch_add(1);
+            }
+        }
+        double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        long distinct = 0;
+        for (auto& node : seen) distinct += node.load() != nullptr;
+        if ((long)solver.get_table().size() != distinct + 1) errors.fetch_add(1); // + 1 for the root
+
+        long total_ops = OPS_PER_THREAD * threads;
+        printf("%8d %12.2f %12.1f %10lu %10ld\n", threads, total_ops / secs / 1e6, secs * 1e9 / total_ops,
+               solver.get_table().size(), errors.load());
+
+        if (threads == max_threads) break;
+    }
+    return 0;
+}
+
+// Bytes per node and the cost of the two Q table hot paths: the selection scan and the backup
+int bench_qtable(const Wordle&) {
+    MemoryArena arena(64);
+    std::mt19937_64 rng(3);
+
+    printf("StateNode header: %zu bytes (+ key)\n", sizeof(StateNode));
+    printf("%8s %12s %12s %14s %14s\n", "actions", "bytes", "bytes/action", "scan ns/action", "update ns");
+
+    for (int n : {16, 256, 4096}) {
+        QTable* table = QTable::create(arena, n);
+        for (int i = 0; i < n; i++) {
+            table->q()[i].store(3.0 + (rng() % 100) / 100.0);
+            table->total_children()[i].store(5);
+            table->solved_children()[i].store(rng() % 3 == 0 ? 5 : 1);
+        }
+
+        // Plain scalar scan of the arrays, the softmax bench has the real selection
+        std::vector<double> logits(n);
+        int reps = (1 << 22) / n;
+        double scan = time_op(reps, [&](int) {
+            double sum = 0.0;
+            for (int i = 0; i < n; i++) {
+                if (table->solved(i)) continue;
+                logits[i] = std::exp(-table->q()[i].load(std::memory_order_relaxed) / 0.1);
+                sum += logits[i];
+            }
+            return (long)sum;
+        }) / n;
+
+        double update = time_op(1 << 20, [&](int i) {
+            int a = i % n;
+            table->visit_count()[a].fetch_add(1, std::memory_order_relaxed);
+            return (long)atomic_add(table->q()[a], -1e-9);
+        });
+
+        printf("%8d %12zu %12.1f %14.2f %14.1f\n", n, QTable::bytes(n), (double)QTable::bytes(n) / n, scan, update);
+    }
+    return 0;
+}
+
+int bench_softmax(const Wordle&) {
+    MemoryArena arena(64);
+    std::mt19937_64 gen(5);
+    const double temp = 0.1;
+    const KernelIsa isas[] = {KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512};
+    KernelIsa original = active_kernel_isa();
+
+    printf("%8s %12s", "actions", "exp+rand ns");
+    for (KernelIsa isa : isas) printf(" %10s ns", kernel_isa_name(isa));
+    printf(" %8s\n", "check");
+
+    int errors = 0;
+    for (int n : {16, 256, 4096, NUM_GUESSES}) {
+        QTable* table = QTable::create(arena, n);
+        for (int i = 0; i < n; i++) {
+            table->q()[i].store(3.0 + (gen() % 1000) / 1000.0);
+            table->total_children()[i].store(5);
+            table->solved_children()[i].store(gen() % 3 == 0 ? 5 : 1);
+        }
+
+        // The std::exp + rand() loop this replaced, for reference
+        std::vector<double> logits(n);
+        std::vector<int> valid(n);
+        int reps = std::max(64, (1 << 21) / n);
+        double old = time_op(reps, [&](int) {
+            int num_valid = 0;
+            double sum = 0.0;
+            for (int i = 0; i < n; i++) {
+                if (table->solved(i)) continue;
+                logits[num_valid] = std::exp(-table->q()[i].load(std::memory_order_relaxed) / temp);
+                sum += logits[num_valid];
+                valid[num_valid++] = i;
+            }
+            double r = (double)rand() / RAND_MAX * sum;
+            for (int i = 0; i < num_valid; i++) {
+                r -= logits[i];
+                if (r <= 0) return (long)valid[i];
+            }
+            return (long)valid[num_valid - 1];
+        });
+        printf("%8d %12.1f", n, old);
+
+        // Each ISA has to replay the same picks from the same seed and never pick a solved one. Across ISAs the
+        // float sums round differently, so a draw right on a boundary can land on the neighbour, only count those
+        SoftmaxScratch scratch;
+        std::vector<int> reference;
+        bool ok = true;
+        int differ = 0;
+        for (KernelIsa isa : isas) {
+            if (!kernel_isa_supported(isa)) {
+                printf(" %13s", "-");
+                continue;
+            }
+            set_kernel_isa(isa);
+
+            Rng rng(1);
+            printf(" %13.1f", time_op(reps, [&](int) { return (long)softmax_select(*table, temp, rng, scratch); }));
+
+            Rng replay(42, 7), again(42, 7);
+            std::vector<int> picks(10000);
+            for (int& pick : picks) {
+                pick = softmax_select(*table, temp, replay, scratch);
+                if (pick < 0 || table->solved(pick) || pick != softmax_select(*table, temp, again, scratch)) ok = false;
+            }
+            if (reference.empty()) reference = picks;
+            for (size_t i = 0; i < picks.size(); i++) differ += picks[i] != reference[i];
+        }
+        if (!ok) errors++;
+        printf(" %8s %d/10000 differ across isas\n", ok ? "ok" : "BAD", differ);
+    }
+    set_kernel_isa(original);
+
+    // All solved has nothing to pick
+    QTable* solved = QTable::create(arena, 8);
+    for (int i = 0; i < 8; i++) {
+        solved->total_children()[i].store(1);
+        solved->solved_children()[i].store(1);
+    }
+    Rng rng(1);
+    SoftmaxScratch scratch;
+    if (softmax_select(*solved, temp, rng, scratch) != -1) {
+        printf("all solved table returned an action\n");
+        errors++;
+    }
+    return errors ? 1 : 0;
+}
+
+int bench_arena(const Wordle&) {
+    constexpr long ALLOCS_PER_THREAD = 1 << 20;
+    int max_threads = omp_get_max_threads();
+    int errors = 0;
+
+    printf("%8s %14s %14s %10s %10s %8s\n", "threads", "slab ns", "mutex ns", "slabs", "backing", "check");
+
+    for (int threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+        // Node sized blocks, 48 to 432 bytes
+        MemoryArena arena(threads * 512);
+        std::vector<std::vector<uint64_t*>> blocks(threads);
+        std::atomic<long> bad(0);
+
+        // Only the allocations are timed, touching the memory is page faults and would swamp them
+        auto start = Clock::now();
+        #pragma omp parallel num_threads(threads)
+        {
+            auto& mine = blocks[omp_get_thread_num()];
+            mine.reserve(ALLOCS_PER_THREAD);
+            for (long i = 0; i < ALLOCS_PER_THREAD; i++)
+                mine.push_back(static_cast<uint64_t*>(arena.allocate(48 + (i % 8) * 48, 16)));
+        }
+        double slab_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ALLOCS_PER_THREAD;
+
+        // Every block came back zeroed and no two overlap
+        for (int t = 0; t < threads; t++) {
+            for (long i = 0; i < ALLOCS_PER_THREAD; i++) {
+                if (*blocks[t][i] != 0) bad.fetch_add(1);
+                *blocks[t][i] = (uint64_t)t << 32 | i;
+            }
+        }
+        for (int t = 0; t < threads; t++)
+            for (long i = 0; i < ALLOCS_PER_THREAD; i++)
+                if (*blocks[t][i] != ((uint64_t)t << 32 | i)) bad.fetch_add(1);
+
+        // The old allocator: a mutex around one shared bump pointer
+        MemoryArena shared(threads * 512);
+        std::mutex lock;
+        std::atomic<long> sink(0);
+        start = Clock::now();
+        #pragma omp parallel num_threads(threads)
+        {
+            uintptr_t fold = 0;
+            for (long i = 0; i < ALLOCS_PER_THREAD; i++) {
+                std::lock_guard<std::mutex> guard(lock);
+                fold ^= (uintptr_t)shared.carve(48 + (i % 8) * 48, 16);
+            }
+            sink.fetch_add(fold & 1);
+        }
+        double mutex_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ALLOCS_PER_THREAD;
+
+        if (bad.load()) errors++;
+        printf("%8d %14.1f %14.1f %10lu %10s %8s\n", threads, slab_ns, mutex_ns, arena.slab_count(),
+               arena.page_backing(), bad.load() ? "BAD" : "ok");
+
+        if (threads == max_threads) break;
+    }
+    return errors ? 1 : 0;
+}
+
+int bench_numa(const Wordle&) {
+    constexpr long ALLOCS_PER_THREAD = 1 << 18;
+
+    printf("nodes with memory: %d\n", numa_node_count());
+    for (int node : numa_nodes())
+        printf("  node %d: %zu cpus\n", node, numa_node_cpus(node).size());
+
+    int pinned = numa_pin_omp_threads();
+    printf("threads pinned across %d node(s)\n", pinned);
+
+    #pragma omp parallel
+    {
+        #pragma omp critical
+        printf("  thread %d on node %d\n", omp_get_thread_num(), numa_current_node());
+    }
+
+    // Node sized allocations from every thread, then the same into an arena small enough that nodes spill
+    printf("%10s %8s %12s %12s %10s\n", "arena MB", "regions", "local MB", "remote MB", "local %");
+    int threads = omp_get_max_threads();
+    for (uint64_t mb : {(uint64_t)threads * 256, (uint64_t)threads * 32}) {
+        ArenaOptions options;
+        options.numa = true;
+        MemoryArena arena(mb, options);
+
+        #pragma omp parallel
+        {
+            for (long i = 0; i < ALLOCS_PER_THREAD; i++) {
+                // The home region filling up is the expected way out of the small arena
+                try {
+                    arena.allocate(48 + (i % 8) * 48, 16);
+                } catch (const std::runtime_error&) {
+                    break;
+                }
+            }
+        }
+
+        double local = arena.local_carved() / 1048576.0, remote = arena.remote_carved() / 1048576.0;
+        printf("%10lu %8d %12.1f %12.1f %9.1f%%\n", mb, arena.region_count(), local, remote,
+               100.0 * local / std::max(local + remote, 1e-9));
+    }
+    return 0;
+}
+
+int bench_checkpoint(const Wordle&) {
+    constexpr int NUM_BLOCKS = 1 << 19;
+    constexpr size_t BLOCK_BYTES = 256;
+    constexpr int HOT_BLOCKS = NUM_BLOCKS / 32; // Backups mostly land near the top of the tree, a small part of the arena
+
+    const char* tmp = getenv("TMPDIR");
+    std::string path = std::string(tmp ? tmp : "/tmp") + "/mcdp_bench.ckpt";
+
+    MemoryArena arena(256);
+    std::mt19937_64 rng(17);
+    std::vector<uint64_t*> blocks(NUM_BLOCKS);
+    for (auto& block : blocks) {
+        block = static_cast<uint64_t*>(arena.allocate(BLOCK_BYTES, 64));
+        for (size_t w = 0; w < BLOCK_BYTES / 8; w++) block[w] = rng();
+    }
+
+    Checkpointer checkpointer(arena, path);
+    auto mutate = [&](uint64_t* block) {
+        block[rng() % (BLOCK_BYTES / 8)] = rng();
+        arena.mark_dirty(block, BLOCK_BYTES);
+    };
+    auto image = [&] { return std::vector<std::byte>(arena.base(), arena.base() + arena.get_capacity()); };
+
+    printf("arena used %.1f MB, %d byte chunks\n", arena.used() / 1048576.0, 1 << arena.chunk_bits());
+    printf("%4s %6s %8s %10s %10s %10s %14s\n", "seq", "kind", "chunks", "MB", "pause ms", "write ms", "writes during");
+
+    auto checkpoint = [&] {
+        if (!checkpointer.begin()) return false;
+        // Keep writing in place while the child saves, none of it should show up in this segment
+        long writes = 0;
+        while (checkpointer.busy()) {
+            for (int i = 0; i < 1024; i++) mutate(blocks[rng() % HOT_BLOCKS]);
+            writes += 1024;
+        }
+        bool ok = checkpointer.wait();
+        const CheckpointStats& s = checkpointer.last_stats();
+        printf("%4lu %6s %8lu %10.1f %10.2f %10.1f %14ld\n", s.sequence, s.full ? "full" : "delta", s.chunks,
+               s.bytes / 1048576.0, s.pause_ms, s.write_ms, writes);
+        return ok;
+    };
+
+    int errors = 0;
+    std::vector<std::byte> expected;
+    size_t expected_used = 0;
+    // A full image, then two deltas after in place writes to the hot blocks and appending a few more
+    for (int round = 0; round < 3; round++) {
+        if (round > 0) {
+            for (int i = 0; i < NUM_BLOCKS / 100; i++) mutate(blocks[rng() % HOT_BLOCKS]);
+            for (int i = 0; i < 1000; i++) blocks.push_back(static_cast<uint64_t*>(arena.allocate(BLOCK_BYTES, 64)));
+        }
+        std::vector<std::byte> before = image(); // What the snapshot has to hold, the bench writes stop during begin
+        if (!checkpoint()) errors++;
+        if (round < 2) {
+            expected = std::move(before);
+            expected_used = arena.used();
+        }
+    }
+
+    // Restore has to fall back to the second snapshot, with nothing of the last segment in the arena
+    auto check_restore = [&](const char* what) {
+        MemoryArena restored(256);
+        auto start = Clock::now();
+        bool ok = Checkpointer::restore(path, restored);
+        double restore_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        ok = ok && restored.used() == expected_used && std::memcmp(restored.base(), expected.data(), expected.size()) == 0;
+        printf("restore after a %s last segment: %.1f ms, %s\n", what, restore_ms, ok ? "matches the second snapshot" : "MISMATCH");
+        if (!ok) errors++;
+    };
+
+    // Flip a byte of the last segment's last chunk, just before the trailer
+    FILE* f = fopen(path.c_str(), "rb+");
+    fseeko(f, -static_cast<off_t>(3 * sizeof(uint64_t) + 100), SEEK_END);
+    int byte = fgetc(f);
+    fseeko(f, -1, SEEK_CUR);
+    fputc(byte ^ 0x5a, f);
+    fclose(f);
+    check_restore("corrupt");
+
+    // Then cut into it
+    f = fopen(path.c_str(), "rb+");
+    fseeko(f, 0, SEEK_END);
+    if (ftruncate(fileno(f), ftello(f) - 100) != 0) errors++;
+    fclose(f);
+    check_restore("torn");
+
+    std::remove(path.c_str());
+    return errors ? 1 : 0;
+}
+
+int bench_restore(const Wordle& wordle) {
+    constexpr int NUM_KEYS = 1 << 18;
+    constexpr int SAMPLES = 1000;
+
+    const char* tmp = getenv("TMPDIR");
+    std::string path = std::string(tmp ? tmp : "/tmp") + "/mcdp_bench.arena";
+    std::remove(path.c_str());
+
+    std::mt19937_64 rng(23);
+    std::vector<StateBitmap> keys;
+    std::unordered_set<uint64_t> key_hashes;
+    while ((int)keys.size() < NUM_KEYS) {
+        StateBitmap key = random_state(rng, 1 + rng() % 64);
+        if (key_hashes.insert(StateKey::from_bitmap(key).hash()).second) keys.push_back(key);
+    }
+
+    ArenaOptions options;
+    options.file = path;
+    SolverConfig config;
+    config.table_size_exp = 20;
+
+    // Build it, then close cleanly the way a preempted job would
+    std::vector<uint64_t> offsets(SAMPLES);
+    uint64_t nodes = 0;
+    double persist_ms;
+    {
+        MemoryArena arena(1024, options);
+        Solver solver(wordle, arena, config);
+        for (auto& key : keys) solver.get_or_create_node(StateKey::from_bitmap(key));
+        for (int i = 0; i < SAMPLES; i++)
+            offsets[i] = arena.offset_of(solver.get_or_create_node(StateKey::from_bitmap(keys[i * (NUM_KEYS / SAMPLES)])));
+        nodes = solver.get_table().size();
+
+        auto start = Clock::now();
+        arena.persist();
+        persist_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Push the file out of the page cache, so both restores below read from disk
+    auto drop_cache = [&] {
+        int fd = open(path.c_str(), O_RDONLY);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    };
+    struct stat st;
+    stat(path.c_str(), &st);
+    printf("%lu nodes, %.1f MB on disk of a %.0f MB arena, persist %.1f ms\n", nodes, st.st_blocks * 512 / 1048576.0,
+           st.st_size / 1048576.0, persist_ms);
+
+    // What restoring by reading everything back costs
+    drop_cache();
+    auto start = Clock::now();
+    {
+        std::vector<std::byte> buffer(1 << 20);
+        int fd = open(path.c_str(), O_RDONLY);
+        while (read(fd, buffer.data(), buffer.size()) > 0) {}
+        close(fd);
+    }
+    double read_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    drop_cache();
+    int errors = 0;
+    start = Clock::now();
+    MemoryArena arena(1024, options);
+    Solver solver(wordle, arena, config);
+    double open_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // Lookups page in just what they touch
+    start = Clock::now();
+    for (int i = 0; i < SAMPLES; i++) {
+        StateNode* node = solver.get_or_create_node(StateKey::from_bitmap(keys[i * (NUM_KEYS / SAMPLES)]));
+        if (arena.offset_of(node) != offsets[i]) errors++;
+    }
+    double lookup_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / SAMPLES;
+    if (!arena.was_restored() || solver.get_table().size() != nodes) errors++;
+
+    printf("%24s %12.2f ms\n", "read whole file", read_ms);
+    printf("%24s %12.2f ms\n", "mmap restore + attach", open_ms);
+    printf("%24s %12.2f us\n", "first lookups, cold", lookup_us);
+    printf("%d errors\n", errors);
+
+    std::remove(path.c_str());
+    return errors ? 1 : 0;
+}
+
+template <typename T> using RawPtr = T*;
+template <typename T> using Rel64 = RelPtr<T>;
+template <typename T> using Rel32 = RelPtr32<T, 2>; // ChainNode links to itself, so its alignment has to be spelled out
+
+// Stand in for StateNode with the same links, built once per pointer flavour with an identical layout
+template <template <typename> class Ptr>
+struct alignas(8) ChainNode {
+    double v;
+    Ptr<ChainNode> next;
+    Ptr<QTable> q_table;
+    Ptr<const ActionList> actions;
+};
+
+// The episode loop's dependent loads: node, its Q table and action list, then on to the next node
+template <template <typename> class Ptr>
+double walk_chain(int num_nodes, long steps, uint64_t& checksum) {
+    constexpr int ACTIONS = 16;
+    constexpr int SHARED = 64; // Nodes share Q tables and lists like siblings share the pool's lists
+    MemoryArena arena(64 + num_nodes * sizeof(ChainNode<Ptr>) / 1048576 * 2);
+    std::mt19937_64 rng(29);
+
+    std::vector<QTable*> tables(SHARED);
+    std::vector<ActionList*> lists(SHARED);
+    for (int i = 0; i < SHARED; i++) {
+        tables[i] = QTable::create(arena, ACTIONS);
+        lists[i] = new (arena.allocate(sizeof(ActionList) + ACTIONS * sizeof(uint16_t), alignof(ActionList)))
+            ActionList{ACTIONS};
+        for (int a = 0; a < ACTIONS; a++) {
+            tables[i]->q()[a].store(rng() % 1000);
+            const_cast<uint16_t*>(lists[i]->guesses())[a] = rng() % NUM_GUESSES;
+        }
+    }
+
+    std::vector<ChainNode<Ptr>*> nodes(num_nodes);
+    for (auto& node : nodes) {
+        node = new (arena.allocate(sizeof(ChainNode<Ptr>), alignof(ChainNode<Ptr>))) ChainNode<Ptr>();
+        node->q_table = tables[rng() % SHARED];
+        node->actions = lists[rng() % SHARED];
+    }
+    // One random cycle through every node, so the walk can't be prefetched
+    std::vector<int> order(num_nodes);
+    for (int i = 0; i < num_nodes; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    for (int i = 0; i < num_nodes; i++) nodes[order[i]]->next = nodes[order[(i + 1) % num_nodes]];
+
+    // Best of 3, the single pass numbers are noisy on a shared box
+    double best = 1e30;
+    for (int rep = 0; rep < 3; rep++) {
+        ChainNode<Ptr>* node = nodes[order[0]];
+        uint64_t fold = 0;
+        auto start = Clock::now();
+        for (long s = 0; s < steps; s++) {
+            int a = s & (ACTIONS - 1);
+            QTable* table = &*node->q_table;
+            fold += node->actions->guesses()[a] + (uint64_t)table->q()[a].load(std::memory_order_relaxed);
+            node = &*node->next;
+        }
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count() / steps);
+        checksum = fold;
+    }
+    return best;
+}
+
+int bench_relptr(const Wordle&) {
+    printf("Node links: raw %zu bytes, RelPtr %zu, RelPtr32 %zu. StateNode header %zu bytes\n",
+           sizeof(ChainNode<RawPtr>) - 8, sizeof(ChainNode<Rel64>) - 8, sizeof(ChainNode<Rel32>) - 8, sizeof(StateNode));
+    printf("%10s %12s %12s %12s %8s\n", "nodes", "raw ns", "RelPtr ns", "RelPtr32 ns", "check");
+
+    int errors = 0;
+    for (int num_nodes : {1 << 10, 1 << 16, 1 << 22}) {
+        long steps = num_nodes >= (1 << 20) ? 1 << 22 : 1 << 25;
+        uint64_t raw_sum, rel_sum, rel32_sum;
+        double raw = walk_chain<RawPtr>(num_nodes, steps, raw_sum);
+        double rel = walk_chain<Rel64>(num_nodes, steps, rel_sum);
+        double rel32 = walk_chain<Rel32>(num_nodes, steps, rel32_sum);
+        bool ok = raw_sum == rel_sum && raw_sum == rel32_sum;
+        if (!ok) errors++;
+        printf("%10d %12.2f %12.2f %12.2f %8s\n", num_nodes, raw, rel, rel32, ok ? "ok" : "BAD");
+    }
+    return errors ? 1 : 0;
+}
+
+// States a real game reaches: random guesses against a random answer from the full list until it's in [lo, hi]
+std::vector<std::vector<uint16_t>> played_states(const Wordle& wordle, std::mt19937_64& rng, int lo, int hi, int count) {
+    std::vector<std::vector<uint16_t>> out;
+    std::unordered_set<uint64_t> seen;
+    while ((int)out.size() < count) {
+        std::vector<uint16_t> state(NUM_ANSWERS);
+        for (int i = 0; i < NUM_ANSWERS; i++) state[i] = i;
+        int answer = rng() % NUM_ANSWERS;
+        while ((int)state.size() > hi) {
+            int guess = rng() % NUM_GUESSES;
+            uint8_t pattern = wordle.get_pattern_lookup(guess, answer);
+            std::vector<uint16_t> next;
+            for (uint16_t a : state)
+                if (wordle.get_pattern_lookup(guess, a) == pattern) next.push_back(a);
+            state.swap(next);
+        }
+        if ((int)state.size() >= lo && seen.insert(StateKey::from_list(state.data(), state.size()).hash()).second)
+            out.push_back(state);
+    }
+    return out;
+}
+
+// Straight from the definition, no bounds, no dedupe, no closed forms. Only usable on a handful of answers
+double reference_dp(const Wordle& wordle, const std::vector<uint16_t>& state, std::map<std::vector<uint16_t>, double>& memo) {
+    auto it = memo.find(state);
+    if (it != memo.end()) return it->second;
+
+    int n = state.size();
+    double best = INFINITY;
+    std::vector<std::vector<uint16_t>> buckets(NUM_PATTERNS);
+    for (int g = 0; g < NUM_GUESSES; g++) {
+        for (auto& b : buckets) b.clear();
+        for (uint16_t a : state) buckets[wordle.get_pattern_lookup(g, a)].push_back(a);
+
+        double q = 1.0;
+        bool useless = false;
+        for (int p = 0; p < NUM_PATTERNS && !useless; p++) {
+            if (p == PATTERN_SOLVED || buckets[p].empty()) continue;
+            if ((int)buckets[p].size() == n) useless = true;
+            else q += (double)buckets[p].size() / n * reference_dp(wordle, buckets[p], memo);
+        }
+        if (!useless) best = std::min(best, q);
+    }
+    memo[state] = best;
+    return best;
+}
+
+// Cold solves into an empty table, then the same states again once they're memoized
+int bench_dp(const Wordle& wordle) {
+    constexpr int STATES = 40;
+    std::mt19937_64 rng(31);
+    int errors = 0;
+
+    printf("%8s %8s %8s %12s %12s %10s %8s %10s %10s %8s\n", "answers", "avg n", "avg V", "cold ms", "warm us",
+           "memo nodes", "kept %", "expanded", "cutoffs", "check");
+
+    for (auto [lo, hi] : {std::pair{3, 5}, {6, 10}, {11, 20}, {21, 40}, {41, 80}}) {
+        std::vector<std::vector<uint16_t>> states = played_states(wordle, rng, lo, hi, STATES);
+
+        MemoryArena arena(512);
+        TranspositionTable<StateNode> table(arena, 20);
+        DpSolver dp(wordle.get_lut(), arena, table);
+
+        std::vector<double> values(STATES);
+        double sum_n = 0, sum_v = 0;
+        auto start = Clock::now();
+        for (int i = 0; i < STATES; i++) {
+            values[i] = dp.evaluate(StateKey::from_list(states[i].data(), states[i].size()));
+            sum_n += states[i].size();
+            sum_v += values[i];
+        }
+        double cold_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / STATES;
+        DpStats stats = dp.stats();
+
+        start = Clock::now();
+        for (int i = 0; i < STATES; i++) {
+            double v = dp.evaluate(StateKey::from_list(states[i].data(), states[i].size()));
+            if (v != values[i]) errors++;
+        }
+        double warm_us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / STATES;
+
+        // Every value has to match the plain definition, and can never beat the lower bound
+        const char* check = "-";
+        int bad = 0;
+        if (hi <= 5) {
+            std::map<std::vector<uint16_t>, double> memo;
+            for (int i = 0; i < STATES; i++)
+                if (std::abs(reference_dp(wordle, states[i], memo) - values[i]) > 1e-9) bad++;
+            check = bad ? "BAD" : "ok";
+        }
+        for (int i = 0; i < STATES; i++)
+            if (values[i] < DpSolver::lower_bound(states[i].size()) - 1e-9) bad++;
+        if (bad) check = "BAD";
+        errors += bad;
+
+        printf("%4d-%-3d %8.1f %8.4f %12.2f %12.2f %10lu %8.1f %10.1f %10.1f %8s\n", lo, hi, sum_n / STATES,
+               sum_v / STATES, cold_ms, warm_us, table.size(), 100.0 * stats.guesses_kept / stats.guesses_scanned,
+               (double)stats.guesses_expanded / stats.states, (double)stats.cutoffs / stats.states, check);
+    }
+    return errors ? 1 : 0;
+}
+
+// Serial DP against the task parallel one at every thread count, each into its own empty table. Values have to
+// come out identical
+int bench_dp_parallel(const Wordle& wordle) {
+    constexpr int STATES = 12;
+    constexpr int PARALLEL_MIN = 20;
+    std::mt19937_64 rng(37);
+    int max_threads = omp_get_max_threads();
+    int errors = 0;
+
+    printf("%8s %8s %8s %12s %10s %10s\n", "answers", "avg n", "threads", "ms/state", "speedup", "check");
+    for (auto [lo, hi] : {std::pair{21, 40}, {41, 80}}) {
+        std::vector<std::vector<uint16_t>> states = played_states(wordle, rng, lo, hi, STATES);
+        double sum_n = 0;
+        for (auto& state : states) sum_n += state.size();
+
+        auto run = [&](int parallel_min, int threads, std::vector<double>& values) {
+            MemoryArena arena(1024);
+            TranspositionTable<StateNode> table(arena, 21);
+            DpSolver dp(wordle.get_lut(), arena, table, parallel_min);
+            omp_set_num_threads(threads);
+            auto start = Clock::now();
+            for (int i = 0; i < STATES; i++)
+                values[i] = dp.evaluate(StateKey::from_list(states[i].data(), states[i].size()));
+            omp_set_num_threads(max_threads);
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / STATES;
+        };
+
+        std::vector<double> serial(STATES), values(STATES);
+        double serial_ms = run(0, 1, serial);
+        printf("%4d-%-3d %8.1f %8s %12.2f %10s %10s\n", lo, hi, sum_n / STATES, "serial", serial_ms, "1.00", "-");
+
+        for (int threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+            double ms = run(PARALLEL_MIN, threads, values);
+            int bad = 0;
+            for (int i = 0; i < STATES; i++)
+                if (std::abs(values[i] - serial[i]) > 1e-9) bad++;
+            errors += bad;
+            printf("%8s %8s %8d %12.2f %10.2f %10s\n", "", "", threads, ms, serial_ms / ms, bad ? "BAD" : "ok");
+            if (threads == max_threads) break;
+        }
+    }
+    return errors ? 1 : 0;
+}
+
+// Expansions from the root down to just above the DP threshold, per ISA, each into a fresh solver. Kept guesses
+// have to be exactly the first of each distinct pattern vector that splits something, and every Q entry's
+// child count has to match partition_state
+int bench_expand(const Wordle& wordle) {
+    constexpr int STATES = 12;
+    const PatternLUT& lut = wordle.get_lut();
+    std::mt19937_64 rng(41);
+    auto partition = std::make_unique<Partition>();
+    KernelIsa original = active_kernel_isa();
+    int errors = 0;
+
+    std::vector<std::pair<const char*, std::vector<std::vector<uint16_t>>>> bands;
+    std::vector<uint16_t> all(NUM_ANSWERS);
+    for (int i = 0; i < NUM_ANSWERS; i++) all[i] = i;
+    bands.push_back({"root", {all}});
+    bands.push_back({"161-800", played_states(wordle, rng, 161, 800, STATES)});
+    bands.push_back({"41-160", played_states(wordle, rng, 41, 160, STATES)});
+    bands.push_back({"21-40", played_states(wordle, rng, 21, 40, STATES)});
+
+    SolverConfig config;
+    config.table_size_exp = 12;
+    config.action_pool_size_exp = 10;
+
+    printf("%8s %8s %8s %10s %8s %8s %8s %10s %8s\n", "answers", "avg n", "isa", "ms/state", "kept", "useless", "dups",
+           "sig ms", "check");
+    for (auto& [band, states] : bands) {
+        int count = states.size();
+        double sum_n = 0;
+        for (auto& state : states) sum_n += state.size();
+
+        // Reference kept lists, straight from the pattern vectors
+        std::vector<std::vector<uint16_t>> expected(count);
+        for (int i = 0; i < count; i++) {
+            std::map<std::vector<uint8_t>, int> seen;
+            for (int g = 0; g < NUM_GUESSES; g++) {
+                std::vector<uint8_t> patterns;
+                for (uint16_t a : states[i]) patterns.push_back(lut.get(g, a));
+                bool splits = std::count(patterns.begin(), patterns.end(), patterns[0]) != (long)patterns.size();
+                bool hits = std::count(patterns.begin(), patterns.end(), PATTERN_SOLVED) > 0;
+                if ((splits || hits) && seen.emplace(patterns, g).second) expected[i].push_back(g);
+            }
+        }
+
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (!kernel_isa_supported(isa)) continue;
+            set_kernel_isa(isa);
+
+            MemoryArena arena(256);
+            Solver solver(wordle, arena, config);
+            std::vector<StateNode*> nodes;
+            for (auto& state : states) nodes.push_back(solver.get_or_create_node(StateKey::from_list(state.data(), state.size())));
+
+            ExpandStats sum;
+            auto start = Clock::now();
+            for (StateNode* node : nodes) {
+                ExpandStats stats = solver.expand(node);
+                sum.kept += stats.kept;
+                sum.useless += stats.useless;
+                sum.duplicates += stats.duplicates;
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / count;
+
+            // The signature pass on its own
+            auto block = std::make_unique<SignatureBlock>();
+            start = Clock::now();
+            for (auto& state : states)
+                for (int g0 = 0; g0 < NUM_GUESSES; g0 += SIGNATURE_BLOCK)
+                    partition_signatures(lut, state.data(), state.size(), g0, *block);
+            double sig_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / count;
+
+            int bad = 0;
+            for (int i = 0; i < count; i++) {
+                StateNode* node = nodes[i];
+                const uint16_t* kept = node->actions->guesses();
+                if (node->read_status() != NodeStatus::Init || node->num_actions != (int)expected[i].size()
+                    || !std::equal(expected[i].begin(), expected[i].end(), kept)) {
+                    bad++;
+                    continue;
+                }
+                for (int a = 0; a < node->num_actions; a++) {
+                    partition_state(lut, node->key(), kept[a], *partition);
+                    int children = partition->num_buckets - (partition->counts[PATTERN_SOLVED] ? 1 : 0);
+                    if (node->q_table->total_children()[a].load() != children) {
+                        bad++;
+                        break;
+                    }
+                }
+            }
+            errors += bad;
+
+            printf("%8s %8.1f %8s %10.2f %8.1f %8.1f %8.1f %10.2f %8s\n", band, sum_n / count, kernel_isa_name(isa), ms,
+                   (double)sum.kept / count, (double)sum.useless / count, (double)sum.duplicates / count, sig_ms,
+                   bad ? "BAD" : "ok");
+        }
+    }
+    set_kernel_isa(original);
+    return errors ? 1 : 0;
+}
+
+// Expansions down random games, every child once from its parent's list and once from scratch in a second solver.
+// Kept lists have to match, the difference is how many guesses each had to scan. Goes below the DP threshold,
+// so the deeper rows show where inheriting pays off most
+int bench_expand_inherit(const Wordle& wordle) {
+    constexpr int GAMES = 60;
+    constexpr int DEPTHS = 5;
+    constexpr int MIN_ANSWERS = 6;
+    const PatternLUT& lut = wordle.get_lut();
+    std::mt19937_64 rng(43);
+    auto partition = std::make_unique<Partition>();
+    int errors = 0;
+
+    SolverConfig config;
+    config.table_size_exp = 14;
+    config.action_pool_size_exp = 12;
+
+    struct Row {
+        long expansions = 0, answers = 0, inherit_candidates = 0, scan_candidates = 0, gray = 0, kept = 0, bad = 0;
+        double inherit_ms = 0, scan_ms = 0;
+    };
+    std::array<Row, DEPTHS + 1> rows;
+
+    // Inheriting pass first, then the same states from scratch. A thread's slab belongs to one arena at a time,
+    // so going back and forth between two would throw a slab away on every switch
+    struct Expanded {
+        int depth;
+        std::vector<uint16_t> state;
+        std::vector<uint16_t> kept;
+        std::vector<uint8_t> children;
+    };
+    std::vector<Expanded> expanded;
+    {
+        MemoryArena arena(512);
+        Solver inheriting(wordle, arena, config);
+        inheriting.expand(inheriting.get_root());
+        for (int game = 0; game < GAMES; game++) {
+            int answer = rng() % NUM_ANSWERS;
+            StateNode* node = inheriting.get_root();
+            for (int depth = 1; depth <= DEPTHS; depth++) {
+                int guess = node->actions->guesses()[rng() % node->num_actions];
+                partition_state(lut, node->key(), guess, *partition);
+                uint8_t pattern = lut.get(guess, answer);
+                if (pattern == PATTERN_SOLVED || partition->counts[pattern] < MIN_ANSWERS) break;
+
+                StateNode* child = inheriting.get_or_create_node(partition->child(pattern));
+                ExpandStats stats = inheriting.expand(child, node->actions.get());
+                node = child;
+                if (!stats.answers) continue; // Been here already
+
+                Row& row = rows[depth];
+                row.expansions++;
+                row.answers += stats.answers;
+                row.inherit_candidates += stats.candidates;
+                row.gray += stats.gray;
+                row.kept += stats.kept;
+                row.inherit_ms += stats.ms;
+
+                Expanded e{depth, {}, {}, {}};
+                child->key().for_each([&](int a) { e.state.push_back(a); });
+                e.kept.assign(child->actions->guesses(), child->actions->guesses() + child->num_actions);
+                for (int a = 0; a < child->num_actions; a++) e.children.push_back(child->q_table->total_children()[a].load());
+                expanded.push_back(std::move(e));
+            }
+        }
+    }
+    {
+        MemoryArena arena(512);
+        Solver scanning(wordle, arena, config);
+        for (const Expanded& e : expanded) {
+            StateNode* node = scanning.get_or_create_node(StateKey::from_list(e.state.data(), e.state.size()));
+            ExpandStats stats = scanning.expand(node);
+            Row& row = rows[e.depth];
+            row.scan_candidates += stats.candidates;
+            row.scan_ms += stats.ms;
+
+            bool same = node->num_actions == (int)e.kept.size()
+                     && std::equal(e.kept.begin(), e.kept.end(), node->actions->guesses());
+            for (int a = 0; same && a < node->num_actions; a++)
+                same = node->q_table->total_children()[a].load() == e.children[a];
+            if (!same) row.bad++;
+        }
+    }
+
+    printf("%6s %6s %8s %10s %10s %8s %8s %10s %10s %8s %6s\n", "depth", "count", "avg n", "inherited", "scanned",
+           "gray", "kept", "inh ms", "scan ms", "speedup", "check");
+    for (int depth = 1; depth <= DEPTHS; depth++) {
+        const Row& row = rows[depth];
+        if (!row.expansions) continue;
+        double count = row.expansions;
+        errors += row.bad;
+        printf("%6d %6ld %8.1f %10.1f %10.1f %8.1f %8.1f %10.3f %10.3f %8.2f %6s\n", depth, row.expansions,
+               row.answers / count, row.inherit_candidates / count, row.scan_candidates / count, row.gray / count,
+               row.kept / count, row.inherit_ms / count, row.scan_ms / count, row.scan_ms / row.inherit_ms,
+               row.bad ? "BAD" : "ok");
+    }
+    return errors ? 1 : 0;
+}
+
+// Fits the curve behind the fitted heuristics to DP solved states, then runs episodes from the root with each
+// heuristic in a solver of its own and reports how the root's V moves. Every heuristic starts optimistic or
+// pessimistic in its own way, what matters is how soon it settles and on what
+int bench_heuristic(const Wordle& wordle) {
+    const PatternLUT& lut = wordle.get_lut();
+    std::mt19937_64 rng(47);
+
+    std::vector<std::pair<int, double>> samples;
+    {
+        MemoryArena arena(512);
+        TranspositionTable<StateNode> table(arena, 20);
+        DpSolver dp(lut, arena, table);
+        for (auto [lo, hi] : {std::pair{3, 5}, {6, 10}, {11, 20}, {21, 40}, {41, 80}})
+            for (auto& state : played_states(wordle, rng, lo, hi, 24))
+                samples.push_back({(int)state.size(), dp.evaluate(StateKey::from_list(state.data(), state.size()))});
+    }
+    auto [a, b] = Heuristic::fit_curve(samples);
+    auto rms = [&](double ca, double cb) {
+        Heuristic curve(HeuristicKind::Fitted, 0.0, ca, cb);
+        double sum = 0;
+        for (auto [size, v] : samples) sum += (curve.expected_guesses(size) - v) * (curve.expected_guesses(size) - v);
+        return std::sqrt(sum / samples.size());
+    };
+    printf("curve fit over %zu DP states: a %.4f b %.4f rms %.4f, built in a %.4f b %.4f rms %.4f\n\n", samples.size(),
+           a, b, rms(a, b), CURVE_A, CURVE_B, rms(CURVE_A, CURVE_B));
+
+    // The root's best Q straight from its table, which V follows. Where it settles and how soon the guess behind
+    // it stops changing is the convergence
+    constexpr int CHECKPOINTS[] = {25, 50, 100, 200, 400, 800};
+    printf("%10s %8s %8s %8s %10s %10s %10s\n", "heuristic", "episodes", "best Q", "guess", "ms", "expand ms", "arena MB");
+    for (int h = 0; h < NUM_HEURISTICS; h++) {
+        SolverConfig config;
+        config.heuristic = static_cast<HeuristicKind>(h);
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        int done = 0;
+        double expand_ms = 0;
+        auto start = Clock::now();
+        for (int checkpoint : CHECKPOINTS) {
+            for (; done < checkpoint; done++) expand_ms += solver.run_episode().expand_ms;
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            StateNode* root = solver.get_root();
+            int best = 0;
+            for (int i = 1; i < root->num_actions; i++)
+                if (root->q_table->q()[i].load() < root->q_table->q()[best].load()) best = i;
+            printf("%10s %8d %8.4f %8d %10.0f %10.0f %10zu\n", heuristic_name(config.heuristic), done,
+                   root->q_table->q()[best].load(), root->actions->guesses()[best], ms, expand_ms, arena.used() >> 20);
+        }
+    }
+    return 0;
+}
+
+int bench_unsolved(const Wordle& wordle) {
+    // Same seed both ways, one arena after the other. Re-walks are episodes that ended on a node that was already
+    // solved when they got there, and taught nothing but one more Q update with the same value. A high DP threshold
+    // so subtrees get solved within a few thousand episodes
+    constexpr int CHECKPOINTS[] = {250, 500, 1000, 2000, 4000};
+    printf("%9s %8s %10s %10s %10s %12s %10s\n", "answers", "episodes", "ms", "re-walks", "avg depth", "root solved", "arena MB");
+    for (bool target : {false, true}) {
+        SolverConfig config;
+        config.target_unsolved = target;
+        config.dp_threshold = 60;
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        int done = 0;
+        long rewalks = 0, depth = 0;
+        auto start = Clock::now();
+        for (int checkpoint : CHECKPOINTS) {
+            for (; done < checkpoint; done++) {
+                EpisodeStats stats = solver.run_episode();
+                rewalks += stats.rewalks;
+                depth += stats.sum_depth;
+            }
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            const QTable* root = solver.get_root()->q_table.get();
+            int solved = 0;
+            for (uint32_t i = 0; i < root->num_actions; i++) solved += root->solved(i);
+            printf("%9s %8d %10.0f %10ld %10.2f %12d %10zu\n", target ? "unsolved" : "uniform", done, ms, rewalks,
+                   (double)depth / done, solved, arena.used() >> 20);
+        }
+    }
+    return 0;
+}
+
+// What check_sums() found: entries whose Q isn't 1 plus their children's shares, out of the ones it checked, and
+// the ones it left out because a child they'd synced was synced into another entry too
+struct SumCheck {
+    int bad = 0;
+    int checked = 0;
+    int shared = 0;
+    double worst = 0.0;
+};
+
+// Every Q entry an episode took, against its children: 1 plus each child's share by bucket size of its V once the
+// entry has synced it, or of what the heuristic assumed for it until then. A child synced into two entries can move
+// through either, so the other lags until it settles, and unsettled entries with one of those don't count
+SumCheck check_sums(const Wordle& wordle, const Solver& solver) {
+    struct Child {
+        const StateNode* node;
+        double weight;
+        double assumed;
+        bool synced;
+    };
+    struct Entry {
+        const StateNode* node;
+        int action;
+        std::vector<Child> children;
+    };
+
+    const auto& table = solver.get_table();
+    const Heuristic& heuristic = solver.get_heuristic();
+    auto partition = std::make_unique<Partition>();
+    std::vector<Entry> entries;
+    std::unordered_map<const StateNode*, int> synced_into;
+
+    table.for_each([&](const StateNode* node) {
+        if (node->compact || !node->q_table) return;
+        const QTable* q_table = node->q_table.get();
+        StateKey key = node->key();
+        for (int a = 0; a < node->num_actions; a++) {
+            const SolvedBuckets* record = q_table->record(a);
+            if (!record) continue;
+            partition_state(wordle.get_lut(), key, node->actions->guesses()[a], *partition);
+
+            BucketCounts buckets{};
+            for (int b = 0; b < partition->num_buckets; b++)
+                if (partition->patterns[b] != PATTERN_SOLVED) buckets.counts[partition->patterns[b]] = partition->counts[partition->patterns[b]];
+            Heuristic::Sums sums = heuristic.flat() ? Heuristic::Sums{} : heuristic.sums(buckets);
+            bool hit = partition->counts[PATTERN_SOLVED] > 0;
+            int children = q_table->total_children()[a].load();
+
+            Entry entry{node, a, {}};
+            for (int b = 0; b < partition->num_buckets; b++) {
+                uint8_t p = partition->patterns[b];
+                if (p == PATTERN_SOLVED) continue;
+                StateKey child_key = partition->child(p);
+                Child child{table.find(child_key.hash(), child_key), (double)partition->counts[p] / key.size(),
+                            heuristic.child_value(sums, key.size(), hit, partition->counts[p]), record->synced(p, children)};
+                if (child.synced) synced_into[child.node]++;
+                entry.children.push_back(child);
+            }
+            entries.push_back(std::move(entry));
+        }
+    });
+
+    SumCheck out;
+    for (const Entry& entry : entries) {
+        const QTable* q_table = entry.node->q_table.get();
+        bool settled = q_table->solved(entry.action);
+        double sum = 1.0;
+        bool lagging = false;
+        for (const Child& child : entry.children) {
+            if (child.synced && synced_into[child.node] > 1) lagging = true;
+            sum += child.weight * (child.synced ? child.node->v() : child.assumed);
+        }
+        if (lagging && !settled) {
+            out.shared++;
+            continue;
+        }
+        double error = std::abs(sum - q_table->q()[entry.action].load());
+        out.checked++;
+        out.worst = std::max(out.worst, error);
+        if (error > 1e-6) out.bad++;
+    }
+    return out;
+}
+
+// Episodes from several threads at once with every Q update logged, then checked against a serial replay of the
+// log: each entry's Q and visits have to be exactly what its updates add up to, every node's V and best action
+// have to be its best Q, every entry's solved count has to match its SolvedBuckets bits, and every entry taken has
+// to add up from its children, see check_sums(). More threads than
+// cores on purpose, preemption in the middle of a backup is the interleaving that would lose an update
+int bench_backup(const Wordle& wordle) {
+    constexpr int EPISODES = 400;
+    int errors = 0;
+
+    printf("%8s %8s %10s %10s %8s %8s %8s %8s %8s %8s %8s %8s\n", "threads", "episodes", "ms", "updates", "nodes", "q", "visits",
+           "v", "solved", "entries", "shared", "sums");
+    for (int threads : {1, 2, 4, 8}) {
+        SolverConfig config;
+        config.log_backups = true;
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        auto start = Clock::now();
+        #pragma omp parallel for num_threads(threads) schedule(dynamic)
+        for (int e = 0; e < EPISODES; e++) solver.run_episode();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::vector<Backup> log = solver.get_backup_log();
+        std::sort(log.begin(), log.end(), [](const Backup& a, const Backup& b) {
+            return a.node != b.node ? a.node < b.node : a.action < b.action;
+        });
+
+        int nodes = 0, bad_q = 0, bad_visits = 0, bad_v = 0, bad_solved = 0;
+        for (size_t i = 0; i < log.size();) {
+            const StateNode* node = log[i].node;
+            const QTable* table = node->q_table.get();
+            nodes++;
+            for (; i < log.size() && log[i].node == node;) {
+                int action = log[i].action;
+                double q = 0.0;
+                uint32_t visits = 0;
+                for (; i < log.size() && log[i].node == node && log[i].action == action; i++) {
+                    q += log[i].delta;
+                    visits += log[i].visit;
+                }
+                if (std::abs(q - table->q()[action].load()) > 1e-9) bad_q++;
+                if (visits != table->visit_count()[action].load()) bad_visits++;
+            }
+
+            int best = node->best_action();
+            double v = node->v();
+            bool ok = best >= 0 && table->q()[best].load() == v;
+            for (int a = 0; ok && a < node->num_actions; a++)
+                if (table->q()[a].load() < v) ok = false;
+            bad_v += !ok;
+
+            for (int a = 0; a < node->num_actions; a++) {
+                const SolvedBuckets* record = table->record(a);
+                int children = table->total_children()[a].load();
+                int marked = record ? record->count(children) : 0;
+                if (marked != table->solved_children()[a].load()) bad_solved++;
+            }
+        }
+        SumCheck sums = check_sums(wordle, solver);
+        int bad = bad_q + bad_visits + bad_v + bad_solved + sums.bad;
+        errors += bad;
+        printf("%8d %8d %10.0f %10zu %8d %8d %8d %8d %8d %8d %8d %8d   %s (worst sum off by %.1e)\n", threads, EPISODES, ms,
+               log.size(), nodes, bad_q, bad_visits, bad_v, bad_solved, sums.checked, sums.shared, sums.bad,
+               bad ? "BAD" : "ok", sums.worst);
+    }
+    return errors ? 1 : 0;
+}
+
+// Bounded memory: episodes in batches, and between batches enforce_budget(), one line per reclaim cycle. Then the same episodes without a budget, to see what the evictions cost in root Q.
+// Then a tree that gets everything but the root evicted halfway. The nodes episodes reach again start over from the
+// heuristic, and the entries above them still have to add up after that
+int bench_reclaim(const Wordle& wordle) {
+    constexpr int EPISODES = 2000;
+    constexpr int BATCH = 50;
+    constexpr uint64_t BUDGET_MB = 192;
+
+    auto best_q = [](const Solver& solver) {
+        const QTable* root = &*solver.get_root()->q_table; // Expanded by the first episode, never null here
+        double best = root->q()[0].load();
+        for (uint32_t i = 1; i < root->num_actions; i++) best = std::min(best, root->q()[i].load());
+        return best;
+    };
+
+    printf("%8s %5s %6s %10s %8s %8s %10s %10s %12s %12s %8s\n", "episodes", "gen", "kept", "summarized", "evicted",
+           "copied", "released", "reclaimed", "before MB", "after MB", "ms");
+    double bounded_q, bounded_ms, unbounded_q, unbounded_ms;
+    size_t peak = 0;
+    SumCheck sums;
+    {
+        SolverConfig config;
+        config.memory_budget_mb = BUDGET_MB;
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        auto start = Clock::now();
+        for (int done = 0; done < EPISODES;) {
+            for (int i = 0; i < BATCH; i++, done++) solver.run_episode();
+            peak = std::max(peak, solver.occupancy());
+            for (const ReclaimStats& r : solver.enforce_budget()) {
+                printf("%8d %5d %6d %10d %8d %7zuK %9zuK %9zuK %12.1f %12.1f %8.1f\n", done, r.generation, r.kept,
+                       r.summarized, r.evicted, r.copied_bytes >> 10, r.released_bytes >> 10,
+                       (r.released_bytes - r.copied_bytes) >> 10, r.occupancy_before / 1048576.0,
+                       r.occupancy_after / 1048576.0, r.ms);
+            }
+        }
+        bounded_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        bounded_q = best_q(solver);
+    }
+    // Everything but the root evicted at once, so the next episodes start over on nodes whose V had already moved
+    constexpr int WARMUP = 300;
+    int evicted = 0;
+    {
+        SolverConfig config;
+        config.memory_budget_mb = 1;
+        config.keep_visits = 1 << 30;
+        config.keep_answers = NUM_ANSWERS + 1;
+        config.heuristic_temp = 0.01; // Nearly always the best entry, so V moves
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        for (int i = 0; i < WARMUP; i++) solver.run_episode();
+        for (const ReclaimStats& r : solver.enforce_budget()) evicted += r.evicted;
+        for (int i = 0; i < WARMUP; i++) solver.run_episode();
+        sums = check_sums(wordle, solver);
+    }
+    size_t unbounded_mb;
+    {
+        SolverConfig config;
+        config.table_size_exp = 20;
+        config.action_pool_size_exp = 16;
+        MemoryArena arena(4096);
+        Solver solver(wordle, arena, config);
+
+        auto start = Clock::now();
+        for (int done = 0; done < EPISODES; done++) solver.run_episode();
+        unbounded_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        unbounded_q = best_q(solver);
+        unbounded_mb = solver.occupancy() >> 20;
+    }
+
+    printf("\nbudget %lu MB: peak %zu MB, root best Q %.4f, %.0f ms\n", (unsigned long)BUDGET_MB, peak >> 20, bounded_q, bounded_ms);
+    printf("unbounded:     %zu MB, root best Q %.4f, %.0f ms\n", unbounded_mb, unbounded_q, unbounded_ms);
+    printf("evicted %d after %d episodes, %d more: %d entries add up from their children, %d with a shared child, %d off (worst %.1e)   %s\n",
+           evicted, WARMUP, WARMUP, sums.checked - sums.bad, sums.shared, sums.bad, sums.worst, sums.bad ? "BAD" : "ok");
+    return sums.bad ? 1 : 0;
+}
+
+// Solved subtree summaries: episodes with a high DP threshold, then compact(). Every solved node has to come back
+// from the table with the same V and best guess, and episodes have to carry on over the compact ones.
+// A few thousand episodes hardly ever solve a node that has a Q table, every entry has to be done, so some states
+// past the threshold also get expanded and then marked solved the way a finished backup leaves them
+int bench_compact(const Wordle& wordle) {
+    constexpr int EPISODES = 1500;
+    constexpr int MORE_EPISODES = 500;
+    constexpr int FORCED = 1500;
+
+    SolverConfig config;
+    config.dp_threshold = 60;
+    config.table_size_exp = 20;
+    config.action_pool_size_exp = 16;
+    MemoryArena arena(4096);
+    Solver solver(wordle, arena, config);
+
+    auto start = Clock::now();
+    for (int i = 0; i < EPISODES; i++) solver.run_episode();
+    double run_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::mt19937_64 rng(37);
+    for (const std::vector<uint16_t>& answers : played_states(wordle, rng, config.dp_threshold + 1, 300, FORCED)) {
+        StateNode* node = solver.get_or_create_node(StateKey::from_list(answers.data(), answers.size()));
+        solver.expand(node);
+        if (node->read_status() != NodeStatus::Init) continue;
+        const QTable* q_table = node->q_table.get();
+        int best = 0;
+        for (int a = 1; a < node->num_actions; a++)
+            if (q_table->q()[a].load() < q_table->q()[best].load()) best = a;
+        node->set_value(q_table->q()[best].load(), best);
+        node->set_status(NodeStatus::Solved);
+    }
+
+    struct Expected {
+        std::vector<uint16_t> answers;
+        double v;
+        int guess;
+    };
+    std::vector<Expected> expected;
+    int with_q = 0, born_compact = 0;
+    size_t full_bytes = 0;
+    const StateNode* root = solver.get_root();
+    solver.get_table().for_each([&](const StateNode* node) {
+        if (node->compact) {
+            born_compact++;
+            return;
+        }
+        if (node == root || node->read_status() != NodeStatus::Solved) return;
+        full_bytes += sizeof(StateNode) + StateKey::storage_bytes(node->key_size);
+        if (node->q_table) {
+            with_q++;
+            full_bytes += QTable::bytes(node->num_actions);
+        }
+
+        Expected e;
+        node->key().for_each([&](int a) { e.answers.push_back(static_cast<uint16_t>(a)); });
+        e.v = node->v();
+        int best = node->best_action();
+        e.guess = best >= 0 ? node->actions->guesses()[best] : node->best_guess;
+        if (e.guess == StateNode::NO_GUESS) e.guess = -1;
+        expected.push_back(std::move(e));
+    });
+
+    CompactStats stats = solver.compact();
+
+    int errors = 0;
+    for (const Expected& e : expected) {
+        StateKey key = StateKey::from_list(e.answers.data(), e.answers.size());
+        const StateNode* node = solver.get_table().find(key.hash(), key);
+        int guess = node && node->best_guess != StateNode::NO_GUESS ? node->best_guess : -1;
+        if (!node || !node->compact || node->v() != e.v || guess != e.guess) errors++;
+    }
+
+    printf("%d episodes with dp_threshold %d in %.0f ms: %d nodes born compact from the DP\n", EPISODES,
+           config.dp_threshold, run_ms, born_compact);
+    printf("compact: %d solved nodes, %d with Q tables, %zu KB of full nodes and Q tables down to %zu KB of records, %zu KB freed, "
+           "%zu KB of chunks released, occupancy %.1f -> %.1f MB, %.1f ms\n",
+           stats.compacted, with_q, full_bytes >> 10, stats.record_bytes >> 10, stats.freed_bytes >> 10,
+           stats.released_bytes >> 10, stats.occupancy_before / 1048576.0, stats.occupancy_after / 1048576.0, stats.ms);
+    printf("checked %zu: %d wrong %s\n", expected.size(), errors, errors ? "BAD" : "ok");
+
+    start = Clock::now();
+    for (int i = 0; i < MORE_EPISODES; i++) solver.run_episode();
+    double more_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    const QTable* q_table = &*root->q_table; // The root is never compacted, so its table is still there
+    double best = q_table->q()[0].load();
+    for (uint32_t i = 1; i < q_table->num_actions; i++) best = std::min(best, q_table->q()[i].load());
+    printf("%d more episodes in %.0f ms, root best Q %.4f, occupancy %.1f MB\n", MORE_EPISODES, more_ms, best,
+           solver.occupancy() / 1048576.0);
+    return errors ? 1 : 0;
+}
+
+// Episode throughput against threads: the old omp for with a barrier every batch, the work stealing scheduler, and the
+// scheduler without virtual loss. Root spread is how many root entries got walked, virtual loss should raise it.
+// Thread counts go up to 128 but stop at twice the hardware threads, past that it's only measuring the OS
+int bench_scaling(const Wordle& wordle) {
+    constexpr long EPISODES = 400;
+    constexpr int BATCH_PER_THREAD = 4;
+    int procs = omp_get_num_procs();
+    int errors = 0;
+    printf("%d hardware threads\n", procs);
+    printf("%8s %12s %8s %10s %10s %8s %8s %10s %8s %8s %8s\n", "threads", "mode", "episodes", "ms", "per sec", "speedup",
+           "eff %", "handoffs", "stolen", "spread", "check");
+
+    double base[3] = {0, 0, 0};
+    for (int threads = 1; threads <= 128 && threads <= std::max(2 * procs, 4); threads *= 2) {
+        for (int mode = 0; mode < 3; mode++) {
+            SolverConfig config;
+            config.table_size_exp = 20;
+            config.action_pool_size_exp = 16;
+            config.virtual_loss = mode == 2 ? 0.0 : config.virtual_loss;
+            MemoryArena arena(4096);
+            Solver solver(wordle, arena, config);
+
+            SchedulerStats stats;
+            if (mode == 0) {
+                auto start = Clock::now();
+                for (long done = 0; done < EPISODES; done += BATCH_PER_THREAD * threads) {
+                    long batch = std::min<long>(BATCH_PER_THREAD * threads, EPISODES - done);
+                    #pragma omp parallel for num_threads(threads) schedule(dynamic)
+                    for (long e = 0; e < batch; e++) solver.run_episode();
+                }
+                stats.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                stats.episodes = EPISODES;
+            } else {
+                SchedulerConfig scheduling;
+                scheduling.threads = threads;
+                stats = EpisodeScheduler(solver, scheduling).run(EPISODES);
+            }
+
+            const StateNode* root = solver.get_root();
+            const QTable* q_table = root->q_table.get();
+            int spread = 0;
+            for (int a = 0; a < root->num_actions; a++) spread += q_table->visit_count()[a].load() > 0;
+
+            // Every walk got backed up, so nothing can still be in flight
+            long left = 0;
+            solver.get_table().for_each([&](const StateNode* node) {
+                if (node->compact || !node->q_table) return;
+                for (int a = 0; a < node->num_actions; a++) left += node->q_table->in_flight()[a].load();
+            });
+            if (left) errors++;
+
+            double rate = stats.episodes / (stats.ms / 1000.0);
+            if (threads == 1) base[mode] = rate;
+            const char* names[] = {"batch", "steal", "steal no vl"};
+            printf("%8d %12s %8ld %10.0f %10.1f %8.2f %8.0f %10ld %8ld %8d %8s\n", threads, names[mode], stats.episodes,
+                   stats.ms, rate, rate / base[mode], 100.0 * rate / base[mode] / threads, stats.handoffs,
+                   stats.stolen, spread, left ? "BAD" : "ok");
+        }
+    }
+    return errors ? 1 : 0;
+}
+
+// This binary and this run's options minus --bench, for benches that start more processes of it
+std::vector<std::string> self_command() {
+    char exe[4096];
+    ssize_t exe_len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (exe_len <= 0) return {};
+    exe[exe_len] = '\0';
+
+    std::vector<std::string> args;
+    std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+    std::string arg;
+    while (std::getline(cmdline, arg, '\0')) args.push_back(arg);
+
+    std::vector<std::string> command = {exe};
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--bench") i++;
+        else if (args[i].rfind("--bench=", 0) != 0) command.push_back(args[i]);
+    }
+    return command;
+}
+
+// Worker processes on one shared arena: a few intervals of stats, checkpoints taken with everyone parked, and a worker
+// killed mid batch and restarted. Then nothing may be left in flight, and the last checkpoint has to restore to the
+// same tree. Workers are this binary again, with this run's options minus --bench
+int bench_shared(const Wordle& wordle) {
+    constexpr int WORKERS = 3;
+    constexpr int INTERVALS = 8;
+    constexpr int INTERVAL_MS = 1500;
+    constexpr int KILL_AT = 4;
+
+    // A memfd, so nothing is left behind in /dev/shm if this dies. Workers open it through our fd table
+    int fd = memfd_create("mcdp-shared", 0);
+    if (fd < 0) return 1;
+    std::string path = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+    const char* tmp = getenv("TMPDIR");
+    std::string log_path = std::string(tmp ? tmp : "/tmp") + "/mcdp_shared.ckpt";
+    std::remove(log_path.c_str());
+
+    std::vector<std::string> command = self_command();
+    if (command.empty()) return 1;
+    command.push_back("--shared-worker");
+    command.push_back(path);
+
+    SolverConfig config;
+    config.table_size_exp = 20;
+    config.action_pool_size_exp = 16;
+    SchedulerConfig scheduling;
+    scheduling.threads = 1;
+
+    int errors = 0;
+    uint64_t nodes = 0;
+    double root_v = 0.0;
+    {
+        ArenaOptions options;
+        options.file = path;
+        options.shared = true;
+        MemoryArena arena(4096, options);
+        Solver solver(wordle, arena, config);
+        Checkpointer checkpointer(arena, log_path); // Before any worker, so they all mark into the shared bits
+        Coordinator coordinator(solver, arena, config, scheduling, 4, command);
+        for (int w = 0; w < WORKERS; w++)
+            if (coordinator.spawn(w) < 0) errors++;
+
+        printf("%d workers of %d thread on %s\n", WORKERS, scheduling.threads, path.c_str());
+        printf("%8s %10s %10s %8s %6s %10s  %s\n", "interval", "episodes", "per sec", "running", "dead", "stalest ms",
+               "event");
+        uint64_t last = 0;
+        auto mark = Clock::now();
+        for (int i = 1; i <= INTERVALS; i++) {
+            usleep(INTERVAL_MS * 1000);
+            char event[160] = "";
+            if (i % 3 == 0) {
+                bool ok = coordinator.checkpoint(checkpointer);
+                const CheckpointStats& s = checkpointer.last_stats();
+                snprintf(event, sizeof(event), "checkpoint %lu %s: %lu chunks, %.1f MB, %.0f ms %s", s.sequence,
+                         s.full ? "full" : "delta", s.chunks, s.bytes / 1048576.0, s.write_ms, ok ? "" : "FAILED");
+                if (!ok) errors++;
+            }
+            if (i == KILL_AT) {
+                kill(coordinator.pid_of(0), SIGKILL);
+                int dead = 0;
+                for (int tries = 0; tries < 1000 && !dead; tries++) {
+                    dead = coordinator.reap();
+                    if (!dead) usleep(1000);
+                }
+                SharedStats s = coordinator.stats();
+                RecoverStats recovered = coordinator.recover();
+                bool ok = dead == 1 && s.dead == 1 && recovered.paused && coordinator.spawn(0) > 0;
+                snprintf(event, sizeof(event),
+                         "killed worker 0 (%d dead), broke %d locks, abandoned %lu claims, cleared in flight, restarted %s",
+                         s.dead, recovered.locks, recovered.claims, ok ? "" : "FAILED");
+                if (!ok) errors++;
+            }
+
+            SharedStats stats = coordinator.stats();
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - mark).count();
+            mark = Clock::now();
+            printf("%8d %10lu %10.1f %8d %6d %10.0f  %s\n", i, stats.episodes, (stats.episodes - last) / (ms / 1000.0),
+                   stats.running, stats.dead, stats.stalest_ms, event);
+            last = stats.episodes;
+        }
+        coordinator.stop_workers();
+
+        // Every batch ran to the end, so only the killed worker could have left entries in flight, and those got cleared
+        long left = 0;
+        solver.get_table().for_each([&](const StateNode* node) {
+            if (node->compact || !node->q_table) return;
+            for (int a = 0; a < node->num_actions; a++) left += node->q_table->in_flight()[a].load();
+        });
+        if (left) errors++;
+
+        if (!checkpointer.begin() || !checkpointer.wait()) errors++;
+        nodes = solver.get_table().size();
+        root_v = solver.get_root()->v();
+        printf("stopped after %lu episodes: %lu nodes, root V %.4f, %ld left in flight %s\n", last, nodes, root_v, left,
+               left ? "BAD" : "ok");
+    }
+    close(fd);
+
+    MemoryArena restored(4096);
+    bool ok = Checkpointer::restore(log_path, restored);
+    if (ok) {
+        Solver solver(wordle, restored, config);
+        ok = solver.get_table().size() == nodes && solver.get_root()->v() == root_v;
+    }
+    printf("restore of the last checkpoint into a private arena: %s\n", ok ? "same tree" : "MISMATCH");
+    std::remove(log_path.c_str());
+    return errors || !ok ? 1 : 0;
+}
+
+// Partitioned solving with 1, 2 and 4 ranks on this machine, the same episodes in total split between them. Rank 0
+// is this process, the rest are this binary again with --partition-dir. Messages and bytes per episode carry over
+// to a cluster as they are, times only with a core per rank
+int bench_sharded(const Wordle& wordle) {
+    constexpr long EPISODES = 480;
+    std::vector<std::string> base = self_command();
+    if (base.empty()) return 1;
+    const char* tmp = getenv("TMPDIR");
+    std::string dir = std::string(tmp ? tmp : "/tmp") + "/mcdp_sharded_" + std::to_string(getpid());
+
+    int errors = 0;
+    printf("%d hardware threads\n", omp_get_num_procs());
+    printf("%6s %8s %10s %10s %8s %10s %10s %10s %8s %10s %8s %8s\n", "ranks", "episodes", "ms", "per sec", "parked %",
+           "msgs/ep", "bytes/ep", "msgs/batch", "stalls", "remote %", "root V", "check");
+    for (int ranks = 1; ranks <= 4; ranks *= 2) {
+        mkdir(dir.c_str(), 0700);
+        long per_rank = EPISODES / ranks;
+        std::vector<pid_t> children;
+        for (int r = 1; r < ranks; r++) {
+            std::vector<std::string> command = base;
+            for (const std::string& arg : {std::string("--partition-dir"), dir, std::string("--rank"), std::to_string(r),
+                                           std::string("--ranks"), std::to_string(ranks), std::string("--episodes"),
+                                           std::to_string(per_rank)})
+                command.push_back(arg);
+            std::vector<char*> argv;
+            for (std::string& arg : command) argv.push_back(arg.data());
+            argv.push_back(nullptr);
+            pid_t pid;
+            if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return 1;
+            children.push_back(pid);
+        }
+
+        std::vector<PartitionStats> all;
+        {
+            UnixSocketTransport transport(dir, 0, ranks);
+            all = solve_partitioned(wordle, transport, per_rank);
+        }
+        bool ok = true;
+        for (pid_t pid : children) {
+            int status;
+            ok = ok && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        rmdir(dir.c_str());
+
+        long episodes = 0, parked = 0, messages = 0, left = 0;
+        uint64_t bytes = 0, batches = 0, stalls = 0, nodes = 0, remote = 0;
+        double ms = 0.0, root_v = 0.0;
+        for (const PartitionStats& s : all) {
+            episodes += s.episodes;
+            parked += s.parked;
+            messages += s.descends_sent + s.results_sent;
+            left += s.left_in_flight + s.left_parked;
+            bytes += s.bytes_sent;
+            batches += s.batches_sent;
+            stalls += s.stalls;
+            nodes += s.nodes;
+            remote += s.remote_nodes;
+            ms = std::max(ms, s.ms);
+            root_v = s.rank == 0 ? s.share_v : std::min(root_v, s.share_v);
+        }
+        ok = ok && static_cast<int>(all.size()) == ranks && episodes == per_rank * ranks && left == 0;
+        if (!ok) errors++;
+        printf("%6d %8ld %10.0f %10.1f %8.1f %10.2f %10.0f %10.1f %8lu %10.1f %8.4f %8s\n", ranks, episodes, ms,
+               episodes / (ms / 1000.0), 100.0 * parked / std::max(episodes, 1L), double(messages) / std::max(episodes, 1L),
+               double(bytes) / std::max(episodes, 1L), batches ? double(messages) / batches : 0.0, stalls,
+               nodes ? 100.0 * remote / nodes : 0.0, root_v, ok ? "ok" : "BAD");
+    }
+    return errors ? 1 : 0;
+}
+
+struct Benchmark {
+    const char* name;
+    int (*run)(const Wordle&);
+};
+
+const Benchmark BENCHMARKS[] = {
+    {"partition", bench_partition},
+    {"bitmap", bench_bitmap},
+    {"table", bench_table},
+    {"qtable", bench_qtable},
+    {"softmax", bench_softmax},
+    {"arena", bench_arena},
+    {"numa", bench_numa},
+    {"checkpoint", bench_checkpoint},
+    {"restore", bench_restore},
+    {"relptr", bench_relptr},
+    {"dp", bench_dp},
+    {"dp_parallel", bench_dp_parallel},
+    {"expand", bench_expand},
+    {"expand_inherit", bench_expand_inherit},
+    {"heuristic", bench_heuristic},
+    {"unsolved", bench_unsolved},
+    {"backup", bench_backup},
+    {"reclaim", bench_reclaim},
+    {"compact", bench_compact},
+    {"scaling", bench_scaling},
+    {"shared", bench_shared},
+    {"sharded", bench_sharded},
+};
+
+} // namespace
+
+int run_benchmark(const std::string& name, const Wordle& wordle) {
+    for (const auto& bench : BENCHMARKS) {
+        if (name == bench.name) return bench.run(wordle);
+    }
+
+    fprintf(stderr, "Unknown benchmark '%s'. Options:", name.c_str());
+    for (const auto& bench : BENCHMARKS) fprintf(stderr, " %s", bench.name);
+    fprintf(stderr, "\n");
+    return 1;
+}
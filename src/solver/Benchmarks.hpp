@@ -0,0 +1,6 @@
+#pragma once
+#include "Wordle.hpp"
+#include <string>
+
+// Isolated micro benchmarks for the hot kernels, run with --bench <name>. Returns a process exit code
+int run_benchmark(const std::string& name, const Wordle& wordle);
@@ -0,0 +1,214 @@
+#include "Coordinator.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <new>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+constexpr double CLAIM_SETTLE_MS = 50.0;
+
+uint64_t monotonic_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool parked(WorkerState state) {
+    return state != WorkerState::Running;
+}
+
+} // namespace
+
+SharedControl* Coordinator::find(const MemoryArena& arena) {
+    uint64_t off = arena.get_root(ARENA_ROOT);
+    return off ? arena.at<SharedControl>(off) : nullptr;
+}
+
+Coordinator::Coordinator(Solver& solver, MemoryArena& arena, const SolverConfig& config, const SchedulerConfig& scheduling,
+                         int batch, std::vector<std::string> worker_command)
+    : solver(solver), arena(arena), worker_command(std::move(worker_command)), children(SharedControl::MAX_WORKERS, -1) {
+    if (!arena.is_shared()) throw std::runtime_error("Coordinator needs a shared arena");
+    control = find(arena);
+    if (!control) {
+        control = new (arena.allocate(sizeof(SharedControl), 64)) SharedControl;
+        arena.set_root(ARENA_ROOT, arena.offset_of(control));
+    }
+    control->config = config;
+    control->scheduling = scheduling;
+    control->batch = batch;
+    control->stop.store(0);
+    control->pause.store(0);
+    arena.mark_dirty(control, sizeof(SharedControl));
+}
+
+pid_t Coordinator::spawn(int rank) {
+    std::string rank_arg = std::to_string(rank);
+    std::vector<char*> argv;
+    for (std::string& arg : worker_command) argv.push_back(arg.data());
+    argv.push_back(const_cast<char*>("--rank"));
+    argv.push_back(rank_arg.data());
+    argv.push_back(nullptr);
+
+    WorkerSlot& slot = control->workers[rank];
+    slot.state.store(WorkerState::Free); // Until it attaches and says it's running
+    pid_t pid;
+    if (posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) return -1;
+    slot.pid.store(pid);
+    children[rank] = pid;
+    return pid;
+}
+
+int Coordinator::reap() {
+    int died = 0;
+    for (int rank = 0; rank < SharedControl::MAX_WORKERS; rank++) {
+        WorkerSlot& slot = control->workers[rank];
+        pid_t pid = slot.pid.load();
+        if (pid <= 0) continue;
+
+        bool gone;
+        if (children[rank] == pid) {
+            int status;
+            gone = waitpid(pid, &status, WNOHANG) == pid;
+            if (gone) children[rank] = -1;
+        } else {
+            gone = kill(pid, 0) != 0 && errno == ESRCH; // Started by someone else
+        }
+        if (!gone) continue;
+
+        WorkerState state = slot.state.load();
+        if (state != WorkerState::Exited && state != WorkerState::Dead) {
+            slot.state.store(WorkerState::Dead);
+            dead.push_back(pid);
+            died++;
+        }
+        slot.pid.store(0);
+    }
+    return died;
+}
+
+bool Coordinator::pause_workers(double timeout_ms) {
+    control->pause.store(1);
+    uint64_t deadline = monotonic_ms() + static_cast<uint64_t>(timeout_ms);
+    while (true) {
+        // One dying now could leave the others spinning on its locks or claims and never parking
+        if (reap()) {
+            for (pid_t pid : dead) solver.break_locks(static_cast<uint32_t>(pid));
+            solver.abandon_claims(CLAIM_SETTLE_MS);
+        }
+        bool all = true;
+        for (const WorkerSlot& slot : control->workers)
+            if (slot.pid.load() > 0 && !parked(slot.state.load())) all = false;
+        // A spawned worker that hasn't attached yet is Free, and checks pause before its first batch
+        if (all) return true;
+        if (monotonic_ms() > deadline) return false;
+        usleep(200);
+    }
+}
+
+void Coordinator::resume_workers() {
+    control->pause.store(0);
+}
+
+RecoverStats Coordinator::recover() {
+    // Before pausing, the others may be waiting on these and never get to the end of their batch. Workers are still
+    // running, so a claim only counts as dead once it's stayed unpublished for a while
+    RecoverStats stats;
+    for (pid_t pid : dead) stats.locks += solver.break_locks(static_cast<uint32_t>(pid));
+    stats.claims += solver.abandon_claims(CLAIM_SETTLE_MS);
+    if (!pause_workers()) return stats;
+    stats.paused = true;
+    for (pid_t pid : dead) stats.locks += solver.break_locks(static_cast<uint32_t>(pid)); // Nodes it locked that the scan missed
+    stats.claims += solver.abandon_claims(); // Everyone's parked, what's left unpublished is the dead's
+    dead.clear();
+    solver.clear_in_flight();
+    resume_workers();
+    return stats;
+}
+
+bool Coordinator::checkpoint(Checkpointer& checkpointer) {
+    if (!pause_workers()) return false;
+    // The writer is a fork, but the mapping is shared, so it reads live memory instead of a snapshot
+    bool ok = checkpointer.begin() && checkpointer.wait();
+    resume_workers();
+    return ok;
+}
+
+SharedStats Coordinator::stats() const {
+    SharedStats stats;
+    uint64_t now = monotonic_ms();
+    for (const WorkerSlot& slot : control->workers) {
+        stats.episodes += slot.episodes.load();
+        switch (slot.state.load()) {
+            case WorkerState::Running: {
+                stats.running++;
+                uint64_t beat = slot.heartbeat_ms.load();
+                if (beat && now > beat) stats.stalest_ms = std::max(stats.stalest_ms, static_cast<double>(now - beat));
+                break;
+            }
+            case WorkerState::Paused: stats.paused++; break;
+            case WorkerState::Dead: stats.dead++; break;
+            default: break;
+        }
+    }
+    return stats;
+}
+
+void Coordinator::stop_workers() {
+    control->stop.store(1);
+    for (int rank = 0; rank < SharedControl::MAX_WORKERS; rank++) {
+        if (children[rank] <= 0) continue;
+        int status;
+        waitpid(children[rank], &status, 0);
+        children[rank] = -1;
+        control->workers[rank].pid.store(0);
+    }
+}
+
+/**
+ * run_shared_worker - One worker process of the shared memory mode
+ * @param path - The shared arena, the coordinator has to have made it and still have it open
+ * @param rank - Slot in the control block, also moves the RNG seed
+ * @returns Exit code for the process
+ */
+int run_shared_worker(const Wordle& wordle, const std::string& path, int rank) {
+    ArenaOptions options;
+    options.file = path;
+    options.shared = true;
+    MemoryArena arena(0, options);
+    SharedControl* control = Coordinator::find(arena);
+    if (!arena.was_attached() || !control || rank < 0 || rank >= SharedControl::MAX_WORKERS) {
+        fprintf(stderr, "%s isn't a live shared arena with a coordinator, or rank %d is out of range\n", path.c_str(), rank);
+        return 1;
+    }
+
+    SolverConfig config = control->config;
+    config.seed += rank + 1;
+    Solver solver(wordle, arena, config);
+    EpisodeScheduler scheduler(solver, control->scheduling);
+
+    WorkerSlot& slot = control->workers[rank];
+    slot.pid.store(getpid());
+    slot.heartbeat_ms.store(monotonic_ms());
+    while (!control->stop.load()) {
+        if (control->pause.load()) {
+            slot.state.store(WorkerState::Paused);
+            while (control->pause.load() && !control->stop.load()) usleep(200);
+            continue;
+        }
+        slot.state.store(WorkerState::Running);
+        if (control->pause.load()) continue; // Coordinator may have looked before Running went in
+        SchedulerStats stats = scheduler.run(control->batch);
+        slot.episodes.fetch_add(stats.episodes);
+        slot.heartbeat_ms.store(monotonic_ms());
+    }
+    slot.state.store(WorkerState::Exited);
+    return 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "Checkpointer.hpp"
+#include "MemoryArena.hpp"
+#include "Scheduler.hpp"
+#include "Solver.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <type_traits>
+#include <vector>
+
+// Several solver processes on one host working the one tree, in a shared MemoryArena (ArenaOptions::shared over a
+// /dev/shm file or a memfd). The coordinator process makes the arena, the tree and the control block, then starts
+// workers, which attach by path and run episodes with their own EpisodeScheduler until told to stop. Checkpoints,
+// stats and restarts are the coordinator's, so a worker can be killed, restarted or added without losing anything
+// in memory.
+//
+// Lock free atomics are address free, so every atomic in the tree works across processes the way it does across
+// threads, and everything links by offset, so each process maps the arena wherever it likes. What doesn't carry over:
+// - A process killed holding a node's SpinLock leaves it held, and everyone who gets there spins until recover()
+//   breaks it. Expanding holds one for the whole expansion, so this is the usual case
+// - One killed between claiming a table slot and publishing its node leaves the slot claimed, and anyone probing
+//   for that state waits on it until recover() abandons the claim. Then they make the node themselves
+// - Its walks stay charged as in flight until recover() clears them
+// - Generations are per process, so reclaim() and compact() only see the Q tables the calling process made. Leave
+//   memory_budget_mb at 0 in this mode
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint16_t>::is_always_lock_free
+              && std::atomic<uint8_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free,
+              "Processes share the tree's atomics through the mapping, which only works for lock free ones");
+static_assert(std::is_trivially_copyable_v<SolverConfig> && std::is_trivially_copyable_v<SchedulerConfig>,
+              "Configs get handed to workers through the arena");
+
+enum class WorkerState : uint32_t {
+    Free = 0,       // No process has had this rank yet
+    Running = 1,
+    Paused = 2,
+    Exited = 3,     // Stopped when told to
+    Dead = 4        // Gone without saying so, the coordinator noticed
+};
+
+struct alignas(64) WorkerSlot {
+    std::atomic<int32_t> pid;
+    std::atomic<WorkerState> state;
+    std::atomic<uint64_t> episodes;         // Over every process that has had this rank
+    std::atomic<uint64_t> heartbeat_ms;     // CLOCK_MONOTONIC, which every process on the host shares
+};
+
+// Hangs off arena root Coordinator::ARENA_ROOT
+struct SharedControl {
+    static constexpr int MAX_WORKERS = 64;
+
+    SolverConfig config;            // Every worker's Solver gets this, with the seed moved by its rank
+    SchedulerConfig scheduling;     // Including threads per worker process
+    int batch;                      // Episodes a worker runs between looks at pause and stop
+    std::atomic<uint32_t> pause;
+    std::atomic<uint32_t> stop;
+    WorkerSlot workers[MAX_WORKERS];
+};
+
+struct SharedStats {
+    uint64_t episodes = 0;
+    int running = 0;
+    int paused = 0;
+    int dead = 0;
+    double stalest_ms = 0.0;        // Since the oldest heartbeat among running workers
+};
+
+struct RecoverStats {
+    bool paused = false;            // Nothing else is done if the live workers wouldn't pause
+    int locks = 0;                  // Broken, the dead held them
+    uint64_t claims = 0;            // Table slots abandoned
+};
+
+class Coordinator {
+    Solver& solver;
+    MemoryArena& arena;
+    SharedControl* control;
+    std::vector<std::string> worker_command;
+    std::vector<pid_t> children;    // By rank, -1 once reaped
+    std::vector<pid_t> dead;        // Found by reap() and not recovered yet
+
+public:
+    static constexpr int ARENA_ROOT = 1;
+
+    // Null if nobody has made one in this arena
+    static SharedControl* find(const MemoryArena& arena);
+
+    /**
+     * Coordinator - Makes the control block. The solver has to be built on the arena first, workers attach to its tree
+     * @param batch - Episodes per worker between control checks, which bounds how long a pause takes
+     * @param worker_command - argv of a worker, spawn() adds --rank
+     */
+    Coordinator(Solver& solver, MemoryArena& arena, const SolverConfig& config, const SchedulerConfig& scheduling,
+                int batch, std::vector<std::string> worker_command);
+
+    pid_t spawn(int rank);
+    pid_t pid_of(int rank) const { return control->workers[rank].pid.load(); }
+
+    // Reaps children that exited and marks any running worker whose process is gone as Dead. Returns how many
+    // it found newly dead
+    int reap();
+
+    // Waits for every live worker to finish its batch and park. False on timeout, the pause stays requested
+    bool pause_workers(double timeout_ms = 60000.0);
+    void resume_workers();
+
+    // After reap() found dead workers: breaks their locks and abandons their unpublished table claims, then pauses
+    // the rest and clears what their walks left in flight
+    RecoverStats recover();
+
+    // A checkpoint with every worker parked, they stay parked until it's on disk. Every process marks the same
+    // dirty bits, so these are incremental like a single process's
+    bool checkpoint(Checkpointer& checkpointer);
+
+    SharedStats stats() const;
+
+    // Tells every worker to stop and waits for the ones this coordinator started
+    void stop_workers();
+};
+
+// What --shared-worker runs: attaches to the arena at path as worker rank, runs batches until told to stop
+int run_shared_worker(const Wordle& wordle, const std::string& path, int rank);
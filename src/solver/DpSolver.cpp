@@ -0,0 +1,405 @@
+#include "DpSolver.hpp"
+
+#include "SpinLock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <omp.h>
+
+namespace {
+
+constexpr double EPS = 1e-9;
+constexpr int SIG_SLOTS = 1 << 15; // Over twice NUM_GUESSES, so probes stay short
+
+struct Candidate {
+    double bound;
+    uint16_t guess;
+};
+
+struct Bucket {
+    uint16_t offset;
+    uint16_t count;
+};
+
+// One per recursion depth, so a guess's buckets survive solving its children
+struct Level {
+    std::vector<uint16_t> answers;
+    std::vector<Candidate> candidates;
+    std::vector<uint16_t> sorted;   // Answers grouped by bucket under the guess being evaluated
+    std::vector<Bucket> buckets;
+};
+
+struct Scratch {
+    // Per pattern counters, valid only where stamp matches the current epoch so they never need clearing
+    uint32_t epoch = 0;
+    std::array<uint32_t, NUM_PATTERNS> stamp{};
+    std::array<uint16_t, NUM_PATTERNS> count{};
+    std::array<uint16_t, NUM_PATTERNS> offset{};
+    std::array<uint8_t, NUM_PATTERNS> label{};
+    std::array<uint8_t, NUM_PATTERNS> touched{};
+
+    // Partition signatures seen in the current scan, same trick
+    uint32_t round = 0;
+    std::vector<uint64_t> sig_keys = std::vector<uint64_t>(SIG_SLOTS);
+    std::vector<uint32_t> sig_round = std::vector<uint32_t>(SIG_SLOTS);
+
+    std::vector<std::unique_ptr<Level>> levels;
+
+    uint32_t next_epoch() {
+        if (++epoch == 0) {
+            stamp.fill(0);
+            epoch = 1;
+        }
+        return epoch;
+    }
+
+    void next_round() {
+        if (++round == 0) {
+            std::fill(sig_round.begin(), sig_round.end(), 0);
+            round = 1;
+        }
+    }
+
+    // False if this partition already came up in the current scan
+    bool insert_signature(uint64_t sig) {
+        size_t i = mix64(sig) & (SIG_SLOTS - 1);
+        while (sig_round[i] == round) {
+            if (sig_keys[i] == sig) return false;
+            i = (i + 1) & (SIG_SLOTS - 1);
+        }
+        sig_round[i] = round;
+        sig_keys[i] = sig;
+        return true;
+    }
+
+    Level& level(int depth) {
+        while (static_cast<int>(levels.size()) <= depth) levels.push_back(std::make_unique<Level>());
+        return *levels[depth];
+    }
+};
+
+Scratch& scratch() {
+    static thread_local Scratch s;
+    return s;
+}
+
+// m * lower_bound(m), which is a whole number of guesses
+inline int bound_mass(int m) {
+    int second = std::min(m - 1, NUM_PATTERNS - 1);
+    return 1 + 2 * second + 3 * (m - 1 - second);
+}
+
+// Every guess that splits the state, one per distinct partition, in order of their lower bounds
+void scan_guesses(const PatternLUT& lut, const uint16_t* answers, int n, Scratch& s, std::vector<Candidate>& out) {
+    out.clear();
+    s.next_round();
+
+    for (int g = 0; g < NUM_GUESSES; g++) {
+        const uint8_t* row = lut.guess_row(g);
+        uint32_t epoch = s.next_epoch();
+        int buckets = 0;
+
+        // Patterns relabelled by first appearance, so guesses that group the answers the same way hash the same.
+        // The all green bucket keeps its own label, it's the one that costs nothing
+        uint64_t sig = 0xcbf29ce484222325ULL;
+        for (int i = 0; i < n; i++) {
+            uint8_t p = row[answers[i]];
+            if (s.stamp[p] != epoch) {
+                s.stamp[p] = epoch;
+                s.count[p] = 0;
+                s.label[p] = p == PATTERN_SOLVED ? 255 : buckets;
+                s.touched[buckets++] = p;
+            }
+            s.count[p]++;
+            sig = (sig ^ s.label[p]) * 0x100000001b3ULL;
+        }
+
+        if (buckets == 1 && s.touched[0] != PATTERN_SOLVED) continue; // Learns nothing
+        if (!s.insert_signature(sig)) continue;
+
+        int mass = 0;
+        for (int b = 0; b < buckets; b++) {
+            uint8_t p = s.touched[b];
+            if (p != PATTERN_SOLVED) mass += bound_mass(s.count[p]);
+        }
+        out.push_back({1.0 + static_cast<double>(mass) / n, static_cast<uint16_t>(g)});
+    }
+
+    std::sort(out.begin(), out.end(), [](const Candidate& a, const Candidate& b) {
+        return a.bound < b.bound || (a.bound == b.bound && a.guess < b.guess);
+    });
+}
+
+// Groups the answers by pattern under guess into level.sorted, biggest bucket first. The solved bucket is left out
+void split(const PatternLUT& lut, int guess, int n, Scratch& s, Level& level) {
+    const uint8_t* row = lut.guess_row(guess);
+    uint32_t epoch = s.next_epoch();
+    int buckets = 0;
+    for (int i = 0; i < n; i++) {
+        uint8_t p = row[level.answers[i]];
+        if (s.stamp[p] != epoch) {
+            s.stamp[p] = epoch;
+            s.count[p] = 0;
+            s.touched[buckets++] = p;
+        }
+        s.count[p]++;
+    }
+
+    level.buckets.clear();
+    uint16_t offset = 0;
+    for (int b = 0; b < buckets; b++) {
+        uint8_t p = s.touched[b];
+        if (p == PATTERN_SOLVED) continue;
+        s.offset[p] = offset;
+        level.buckets.push_back({offset, s.count[p]});
+        offset += s.count[p];
+    }
+
+    level.sorted.resize(n);
+    for (int i = 0; i < n; i++) {
+        uint8_t p = row[level.answers[i]];
+        if (p != PATTERN_SOLVED) level.sorted[s.offset[p]++] = level.answers[i];
+    }
+    std::sort(level.buckets.begin(), level.buckets.end(), [](const Bucket& a, const Bucket& b) { return a.count > b.count; });
+}
+
+} // namespace
+
+DpSolver::DpSolver(const PatternLUT& lut, MemoryArena& arena, TranspositionTable<StateNode>& table, int parallel_min)
+    : lut(lut), arena(arena), table(table), parallel_min(parallel_min) {
+    for (auto& c : counters) c.store(0);
+}
+
+double DpSolver::evaluate(const StateKey& state, int* best_guess) {
+    DpStats local;
+    double v;
+    if (parallel_min > 0 && state.size() >= parallel_min && !omp_in_parallel()) {
+        #pragma omp parallel
+        #pragma omp single
+        v = solve(state, 0, best_guess, local);
+    } else {
+        v = solve(state, 0, best_guess, local);
+    }
+    flush(local);
+    return v;
+}
+
+void DpSolver::flush(const DpStats& stats) {
+    uint64_t values[6] = {stats.states, stats.memo_hits, stats.guesses_scanned, stats.guesses_kept,
+                          stats.guesses_expanded, stats.cutoffs};
+    for (int i = 0; i < 6; i++)
+        if (values[i]) counters[i].fetch_add(values[i], std::memory_order_relaxed);
+}
+
+bool DpSolver::memo_lookup(uint64_t hash, const StateKey& state, double& v, int* best_guess) {
+    StateNode* node = table.find(hash, state);
+    if (!node) return false;
+
+    bool solved;
+    int guess;
+    if (node->compact) {
+        solved = true;
+        v = node->v();
+        guess = node->best_guess;
+    } else {
+        node->lock.lock();
+        solved = node->read_status() == NodeStatus::Solved;
+        v = node->v();
+        guess = node->best_guess;
+        node->lock.unlock();
+    }
+    if (solved && best_guess) *best_guess = guess == StateNode::NO_GUESS ? -1 : guess;
+    return solved;
+}
+
+double DpSolver::solve(const StateKey& state, int depth, int* best_guess, DpStats& stats) {
+    int n = state.size();
+    if (n == 0) return 0.0;
+
+    uint64_t hash = state.hash();
+    double memo;
+    if (memo_lookup(hash, state, memo, best_guess)) {
+        stats.memo_hits++;
+        return memo;
+    }
+    if (parallel_min > 0 && n >= parallel_min) return solve_parallel(state, hash, depth, best_guess, stats);
+
+    // Nothing in here is a task scheduling point, so this thread's scratch can't get reused under it
+    Scratch& s = scratch();
+    Level& level = s.level(depth);
+    level.answers.resize(n);
+    int i = 0;
+    state.for_each([&](int a) { level.answers[i++] = static_cast<uint16_t>(a); });
+
+    scan_guesses(lut, level.answers.data(), n, s, level.candidates);
+    stats.states++;
+    stats.guesses_scanned += NUM_GUESSES;
+    stats.guesses_kept += level.candidates.size();
+
+    double floor = lower_bound(n);
+    double best = INFINITY;
+    int best_g = -1;
+
+    for (const Candidate& candidate : level.candidates) {
+        if (candidate.bound >= best - EPS) break; // Sorted, so nothing after this can win either
+
+        split(lut, candidate.guess, n, s, level);
+
+        // Buckets of 1 or 2 are exact in the bound already, only bigger ones need solving
+        double q = candidate.bound;
+        bool cut = false;
+        for (const Bucket& bucket : level.buckets) {
+            if (bucket.count < MEMO_MIN) break;
+            if (&bucket == &level.buckets.front()) stats.guesses_expanded++;
+
+            double v = solve(StateKey::from_list(&level.sorted[bucket.offset], bucket.count), depth + 1, nullptr, stats);
+            q += static_cast<double>(bucket.count) / n * (v - lower_bound(bucket.count));
+            if (q >= best - EPS) {
+                cut = true;
+                break;
+            }
+        }
+        if (cut) {
+            stats.cutoffs++;
+            continue;
+        }
+
+        best = q;
+        best_g = candidate.guess;
+        if (best <= floor + EPS) break; // Hit the bound, it's optimal
+    }
+
+    record(hash, state, best, best_g);
+    if (best_guess) *best_guess = best_g;
+    return best;
+}
+
+// Same search as solve, but its state lives in this frame instead of the thread's scratch, since the tasks
+// run on other threads and this one can pick up other tasks while it waits
+double DpSolver::solve_parallel(const StateKey& state, uint64_t hash, int depth, int* best_guess, DpStats& stats) {
+    int n = state.size();
+    std::vector<uint16_t> answers(n);
+    int i = 0;
+    state.for_each([&](int a) { answers[i++] = static_cast<uint16_t>(a); });
+
+    std::vector<Candidate> candidates;
+    scan_guesses(lut, answers.data(), n, scratch(), candidates);
+    stats.states++;
+    stats.guesses_scanned += NUM_GUESSES;
+    stats.guesses_kept += candidates.size();
+
+    // Q of the best finished guess. The value is exact whatever the timing, but among guesses that tie, which one
+    // gets reported depends on which finished first
+    struct Best {
+        std::atomic<double> q{INFINITY};
+        SpinLock lock;
+        int guess = -1;
+
+        void offer(double value, int g) {
+            std::lock_guard<SpinLock> guard(lock);
+            if (value < q.load(std::memory_order_relaxed) - EPS) {
+                q.store(value, std::memory_order_relaxed);
+                guess = g;
+            }
+        }
+    } best;
+
+    // Candidates go out in waves of a couple per thread. Queueing them all at once lets the runtime run them in
+    // any order, and the good ones that make pruning work tend to come last, which was 10x slower on one thread
+    const double floor = lower_bound(n);
+    const int wave = 2 * omp_get_num_threads();
+    for (int start = 0; start < static_cast<int>(candidates.size()); start += wave) {
+        if (candidates[start].bound >= best.q.load(std::memory_order_relaxed) - EPS) break;
+        if (best.q.load(std::memory_order_relaxed) <= floor + EPS) break; // Optimal, nothing can beat it
+
+        int end = std::min(start + wave, static_cast<int>(candidates.size()));
+        #pragma omp taskgroup
+        for (int c = start; c < end; c++) {
+            if (candidates[c].bound >= best.q.load(std::memory_order_relaxed) - EPS) break;
+
+            #pragma omp task firstprivate(c) shared(candidates, answers, best)
+            {
+                const Candidate& candidate = candidates[c];
+                DpStats local;
+
+                // Bucketed into task owned memory, the scratch can be clobbered by whatever runs here next
+                Level level;
+                level.answers = answers;
+                split(lut, candidate.guess, n, scratch(), level);
+
+                // Running Q: the exact value replaces each bucket's bound as it lands, so it only ever goes up
+                std::atomic<double> q{candidate.bound};
+                std::atomic<bool> cut{false};
+                auto beaten = [&] { return q.load(std::memory_order_relaxed) >= best.q.load(std::memory_order_relaxed) - EPS; };
+
+                if (!beaten()) {
+                    #pragma omp taskgroup
+                    for (const Bucket& bucket : level.buckets) {
+                        if (bucket.count < MEMO_MIN) break;
+                        if (cut.load(std::memory_order_relaxed)) break;
+                        if (&bucket == &level.buckets.front()) local.guesses_expanded++;
+
+                        #pragma omp task firstprivate(bucket) shared(level, q, cut, best)
+                        {
+                            if (beaten()) {
+                                cut.store(true, std::memory_order_relaxed);
+                            } else {
+                                DpStats child;
+                                double v = solve(StateKey::from_list(&level.sorted[bucket.offset], bucket.count), depth + 1,
+                                                 nullptr, child);
+                                atomic_add(q, static_cast<double>(bucket.count) / n * (v - lower_bound(bucket.count)));
+                                if (beaten()) cut.store(true, std::memory_order_relaxed);
+                                flush(child);
+                            }
+                        }
+                    }
+                } else {
+                    cut.store(true, std::memory_order_relaxed);
+                }
+
+                if (cut.load() || beaten()) {
+                    local.cutoffs++;
+                } else {
+                    best.offer(q.load(), candidate.guess);
+                }
+                flush(local);
+            }
+        }
+    }
+
+    double v = best.q.load();
+    record(hash, state, v, best.guess);
+    if (best_guess) *best_guess = best.guess;
+    return v;
+}
+
+// A state nobody has a node for yet gets a compact one. One an episode already made stays full, it's still in
+// that episode's hands
+void DpSolver::record(uint64_t hash, const StateKey& state, double v, int best_guess) {
+    StateNode* node = table.find_or_insert(hash, state, [&] { return StateNode::create_solved(arena, state, v, best_guess); });
+    if (node->compact) return;
+
+    node->lock.lock();
+    if (node->read_status() != NodeStatus::Solved) {
+        node->set_value(v, -1);
+        node->best_guess = static_cast<uint16_t>(best_guess);
+        node->set_status(NodeStatus::Solved);
+        arena.mark_dirty(node, sizeof(StateNode));
+    }
+    node->lock.unlock();
+}
+
+DpStats DpSolver::stats() const {
+    DpStats out;
+    out.states = counters[0].load(std::memory_order_relaxed);
+    out.memo_hits = counters[1].load(std::memory_order_relaxed);
+    out.guesses_scanned = counters[2].load(std::memory_order_relaxed);
+    out.guesses_kept = counters[3].load(std::memory_order_relaxed);
+    out.guesses_expanded = counters[4].load(std::memory_order_relaxed);
+    out.cutoffs = counters[5].load(std::memory_order_relaxed);
+    return out;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "MemoryArena.hpp"
+#include "Nodes.hpp"
+#include "PatternLUT.hpp"
+#include "StateKey.hpp"
+#include "TranspositionTable.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+struct DpStats {
+    uint64_t states = 0;            // Solved from scratch, the rest were memo hits
+    uint64_t memo_hits = 0;
+    uint64_t guesses_scanned = 0;
+    uint64_t guesses_kept = 0;      // Left after dropping useless guesses and duplicate partitions
+    uint64_t guesses_expanded = 0;  // Got as far as evaluating a child
+    uint64_t cutoffs = 0;           // Abandoned once their partial sum passed the best guess
+};
+
+// Exact optimal expected guesses for a state, by full search over every guess with memoization in the
+// solver's transposition table. Each state scans all guesses once: useless ones (one bucket, not the answer)
+// and ones that split the state exactly like an earlier guess are dropped, and the rest are ordered by a
+// lower bound built from their bucket sizes. Children then get solved biggest bucket first, and a guess is
+// abandoned as soon as its exact part plus the bound for the rest can't beat the best one so far.
+//
+// Every state it solves with 3 or more answers ends up as a Solved node, so episodes and later calls
+// reuse it. Smaller ones have a closed form. Safe to call from any thread.
+//
+// States with at least parallel_min answers are solved with OpenMP tasks: one per candidate guess, and one
+// per big bucket inside each. The best Q so far is shared through an atomic, so every task prunes against
+// the best any of them has found, and tasks that start after it's beaten return right away
+class DpSolver {
+    const PatternLUT& lut;
+    MemoryArena& arena;
+    TranspositionTable<StateNode>& table;
+    int parallel_min;
+
+    std::atomic<uint64_t> counters[6];  // DpStats, in field order
+
+    bool memo_lookup(uint64_t hash, const StateKey& state, double& v, int* best_guess);
+    double solve(const StateKey& state, int depth, int* best_guess, DpStats& stats);
+    double solve_parallel(const StateKey& state, uint64_t hash, int depth, int* best_guess, DpStats& stats);
+    void record(uint64_t hash, const StateKey& state, double v, int best_guess);
+    void flush(const DpStats& stats);
+
+public:
+    static constexpr int MEMO_MIN = 3;
+
+    // parallel_min of 0 keeps everything on the calling thread
+    DpSolver(const PatternLUT& lut, MemoryArena& arena, TranspositionTable<StateNode>& table, int parallel_min = 0);
+
+    /**
+     * evaluate - Solves a state exactly and marks its node Solved with the value and guess behind it
+     * @param state - Any size, but past a few dozen answers this gets expensive fast. Big ones called from
+     *                outside a parallel region get a team of their own, inside one they use the current team
+     * @param best_guess - Optional, gets the optimal guess
+     * @returns Expected guesses left with optimal play, counting the one that gets it right
+     */
+    double evaluate(const StateKey& state, int* best_guess = nullptr);
+
+    // Admissible bound on V for n answers: one can be guessed right away, at most 242 more split off into
+    // their own buckets and get solved next guess, everything else takes at least 3
+    static double lower_bound(int n) {
+        if (n <= 0) return 0.0;
+        int second = n - 1 < NUM_PATTERNS - 1 ? n - 1 : NUM_PATTERNS - 1;
+        int rest = n - 1 - second;
+        return (1.0 + 2.0 * second + 3.0 * rest) / n;
+    }
+
+    DpStats stats() const;
+};
@@ -0,0 +1,167 @@
+#include "Heuristic.hpp"
+#include "DpSolver.hpp"
+#include "Partition.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+namespace {
+
+using SumsFn = Heuristic::Sums (*)(const uint16_t*, const float*, const float*);
+
+// Buckets past the state's size are 0, and both tables are 0 at 0, so empty buckets add nothing to any sum
+
+Heuristic::Sums sums_scalar(const uint16_t* counts, const float* entropy_mass, const float* expected_mass) {
+    Heuristic::Sums out{0.0f, 0.0f, 0, 0};
+    for (int p = 0; p < 256; p++) {
+        uint16_t c = counts[p];
+        out.entropy += entropy_mass[c];
+        out.fitted += expected_mass[c];
+        out.squares += static_cast<uint32_t>(c) * c;
+        out.largest = std::max<uint32_t>(out.largest, c);
+    }
+    return out;
+}
+
+__attribute__((target("avx2")))
+Heuristic::Sums sums_avx2(const uint16_t* counts, const float* entropy_mass, const float* expected_mass) {
+    __m256 entropy = _mm256_setzero_ps();
+    __m256 fitted = _mm256_setzero_ps();
+    __m256i squares = _mm256_setzero_si256();
+    __m256i largest = _mm256_setzero_si256();
+    for (int p = 0; p < 256; p += 8) {
+        __m256i c = _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(counts + p)));
+        entropy = _mm256_add_ps(entropy, _mm256_i32gather_ps(entropy_mass, c, 4));
+        fitted = _mm256_add_ps(fitted, _mm256_i32gather_ps(expected_mass, c, 4));
+        squares = _mm256_add_epi32(squares, _mm256_mullo_epi32(c, c));
+        largest = _mm256_max_epu32(largest, c);
+    }
+
+    alignas(32) float e[8], f[8];
+    alignas(32) uint32_t s[8], l[8];
+    _mm256_store_ps(e, entropy);
+    _mm256_store_ps(f, fitted);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(s), squares);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), largest);
+    Heuristic::Sums out{0.0f, 0.0f, 0, 0};
+    for (int i = 0; i < 8; i++) {
+        out.entropy += e[i];
+        out.fitted += f[i];
+        out.squares += s[i];
+        out.largest = std::max(out.largest, l[i]);
+    }
+    return out;
+}
+
+__attribute__((target("avx512f")))
+Heuristic::Sums sums_avx512(const uint16_t* counts, const float* entropy_mass, const float* expected_mass) {
+    __m512 entropy = _mm512_setzero_ps();
+    __m512 fitted = _mm512_setzero_ps();
+    __m512i squares = _mm512_setzero_si512();
+    __m512i largest = _mm512_setzero_si512();
+    for (int p = 0; p < 256; p += 16) {
+        __m512i c = _mm512_cvtepu16_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(counts + p)));
+        entropy = _mm512_add_ps(entropy, _mm512_i32gather_ps(c, entropy_mass, 4));
+        fitted = _mm512_add_ps(fitted, _mm512_i32gather_ps(c, expected_mass, 4));
+        squares = _mm512_add_epi32(squares, _mm512_mullo_epi32(c, c));
+        largest = _mm512_max_epu32(largest, c);
+    }
+    return {_mm512_reduce_add_ps(entropy), _mm512_reduce_add_ps(fitted),
+            static_cast<uint32_t>(_mm512_reduce_add_epi32(squares)), _mm512_reduce_max_epu32(largest)};
+}
+
+// Follows the partition kernel's ISA, so set_kernel_isa switches this too
+SumsFn sums_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return sums_avx512;
+        case KernelIsa::AVX2: return sums_avx2;
+        default: return sums_scalar;
+    }
+}
+
+} // namespace
+
+const char* heuristic_name(HeuristicKind kind) {
+    switch (kind) {
+        case HeuristicKind::Flat: return "flat";
+        case HeuristicKind::Entropy: return "entropy";
+        case HeuristicKind::ExpectedSize: return "expected";
+        case HeuristicKind::MaxBucket: return "max";
+        case HeuristicKind::Fitted: return "fitted";
+    }
+    return "unknown";
+}
+
+Heuristic::Heuristic(HeuristicKind kind, double flat_v, double curve_a, double curve_b)
+    : kind(kind), flat_v(flat_v), curve_a(curve_a), curve_b(curve_b) {
+    expected[0] = expected_mass[0] = entropy_mass[0] = 0.0f;
+    for (int c = 1; c <= NUM_ANSWERS; c++) {
+        double v = c <= 2 ? 1.0 + 0.5 * (c - 1) : std::max(DpSolver::lower_bound(c), curve_a + curve_b * std::log2(c));
+        expected[c] = static_cast<float>(v);
+        expected_mass[c] = static_cast<float>(c * v);
+        entropy_mass[c] = static_cast<float>(c * std::log2(c));
+    }
+}
+
+Heuristic::Sums Heuristic::sums(const BucketCounts& buckets) const {
+    return sums_for(active_kernel_isa())(buckets.counts.data(), entropy_mass.data(), expected_mass.data());
+}
+
+double Heuristic::expected_guesses(double answers) const {
+    if (answers <= 1.0) return 1.0;
+    if (answers >= NUM_ANSWERS) return expected[NUM_ANSWERS];
+    int below = static_cast<int>(answers);
+    double t = answers - below;
+    return expected[below] + t * (expected[below + 1] - expected[below]);
+}
+
+double Heuristic::q(const Sums& sums, int n, bool hit) const {
+    double missed = n - (hit ? 1 : 0); // Answers that need more guesses
+    if (missed == 0) return 1.0;
+
+    switch (kind) {
+        case HeuristicKind::Flat:
+            return 1.0 + missed / n * flat_v;
+        case HeuristicKind::Entropy:
+            return 1.0 + (missed + curve_b * sums.entropy) / n;
+        case HeuristicKind::ExpectedSize:
+            return 1.0 + missed / n * expected_guesses(sums.squares / missed);
+        case HeuristicKind::MaxBucket:
+            return 1.0 + missed / n * expected_guesses(sums.largest);
+        case HeuristicKind::Fitted:
+            return 1.0 + sums.fitted / n;
+    }
+    return 1.0 + missed / n * flat_v;
+}
+
+double Heuristic::child_value(const Sums& sums, int n, bool hit, int child_size) const {
+    switch (kind) {
+        case HeuristicKind::Flat:
+            return flat_v;
+        case HeuristicKind::Entropy:
+            return 1.0 + curve_b * std::log2(child_size);
+        case HeuristicKind::Fitted:
+            return expected[child_size];
+        default:
+            // Q - 1 is n * sum of (c / n) * share, so scaling every fitted value by the same factor adds up
+            return (q(sums, n, hit) - 1.0) * n / sums.fitted * expected[child_size];
+    }
+}
+
+std::pair<double, double> Heuristic::fit_curve(const std::vector<std::pair<int, double>>& samples) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int count = 0;
+    for (auto [size, v] : samples) {
+        if (size < 3) continue;
+        double x = std::log2(size);
+        sx += x;
+        sy += v;
+        sxx += x * x;
+        sxy += x * v;
+        count++;
+    }
+    if (count < 2) return {0.0, 0.0};
+    double b = (count * sxy - sx * sy) / (count * sxx - sx * sx);
+    return {(sy - b * sx) / count, b};
+}
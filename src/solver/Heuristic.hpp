@@ -0,0 +1,86 @@
+#pragma once
+#include "GameTypes.hpp"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// What expand() estimates a guess's initial Q from
+enum class HeuristicKind : uint8_t {
+    Flat = 0,           // Every child at the same value, no bucket sizes needed
+    Entropy = 1,        // Bits left after the guess, at a fixed number of guesses per bit
+    ExpectedSize = 2,   // Expected size of the bucket the answer lands in
+    MaxBucket = 3,      // Size of the biggest bucket
+    Fitted = 4          // Fitted expected guesses for each bucket's size, summed over the buckets
+};
+
+constexpr int NUM_HEURISTICS = 5;
+
+const char* heuristic_name(HeuristicKind kind);
+
+// One guess's bucket sizes over a state, by pattern. Padded to 256 so the kernels run without a tail.
+// The solved bucket has to be left at 0, Heuristic takes whether it was hit separately
+struct alignas(64) BucketCounts {
+    std::array<uint16_t, 256> counts;
+};
+
+// Initial Q for a guess from its bucket sizes, and how much of that Q each child accounts for.
+//
+// Episodes update a Q by how much a child's V moved since the last visit, starting from what the Q assumed
+// for it. So the Q and the children's shares have to add up: Q = 1 + sum over buckets of (c / n) * share.
+// Flat, Entropy and Fitted come from a per size value to begin with. ExpectedSize and MaxBucket don't, so
+// their Q gets split across the buckets in proportion to the fitted value of each size.
+//
+// The fitted curve is expected optimal guesses for c answers: exact at 1 and 2, a + b * log2(c) after that,
+// never below DpSolver's lower bound
+class Heuristic {
+    HeuristicKind kind;
+    double flat_v;
+    double curve_a;
+    double curve_b;
+
+    alignas(64) std::array<float, NUM_ANSWERS + 1> expected;       // Fitted curve at each size
+    alignas(64) std::array<float, NUM_ANSWERS + 1> expected_mass;  // c * expected[c], what Fitted sums
+    alignas(64) std::array<float, NUM_ANSWERS + 1> entropy_mass;   // c * log2(c), what Entropy sums
+
+public:
+    // Everything the kinds need, from one pass over the buckets
+    struct Sums {
+        float entropy;      // Sum of c * log2(c)
+        float fitted;       // Sum of c * expected[c]
+        uint32_t squares;   // Sum of c * c
+        uint32_t largest;
+    };
+
+    Heuristic(HeuristicKind kind, double flat_v, double curve_a, double curve_b);
+
+    HeuristicKind get_kind() const { return kind; }
+
+    // True when Q doesn't depend on the bucket sizes at all, expand() skips counting them
+    bool flat() const { return kind == HeuristicKind::Flat; }
+
+    Sums sums(const BucketCounts& buckets) const;
+
+    /**
+     * q - Initial Q for one guess
+     * @param sums - From the guess's bucket sizes, without the solved one
+     * @param n - Answers in the state
+     * @param hit - Whether the guess is one of them
+     */
+    double q(const Sums& sums, int n, bool hit) const;
+
+    /**
+     * child_value - The V a fresh child was assumed to have when its parent's Q got initialized
+     * @param sums - The parent's guess's Sums, from the same buckets q() got
+     * @param child_size - Answers in the child's bucket
+     */
+    double child_value(const Sums& sums, int n, bool hit, int child_size) const;
+
+    // Fitted curve between sizes, so ExpectedSize can use a fractional one
+    double expected_guesses(double answers) const;
+
+    // Least squares a + b * log2(size) through (size, optimal V) samples. Sizes under 3 are exact already
+    // and get skipped
+    static std::pair<double, double> fit_curve(const std::vector<std::pair<int, double>>& samples);
+};
@@ -0,0 +1,330 @@
+#pragma once
+#include "ActionPool.hpp"
+#include "GameTypes.hpp"
+#include "MemoryArena.hpp"
+#include "RelPtr.hpp"
+#include "SpinLock.hpp"
+#include "StateKey.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+// Which of one Q entry's child buckets are solved, so episodes can send their answer into one that isn't, and which
+// ones the entry's Q has caught up on, see Solver::walk. Entries with few children list their patterns in 12 bytes
+// with a bit per list slot after them, 16 bytes in all, the rest take 64 bytes for a bit per pattern. The form
+// follows from the entry's total_children, so it isn't stored. The solved bucket has no child and is never in here.
+// Only made once an episode takes the entry, most entries never get taken
+struct alignas(16) SolvedBuckets {
+    static constexpr int LIST_MAX = 12;
+
+private:
+    static constexpr int SOLVED = 0;
+    static constexpr int SYNCED = 1;
+
+    static bool listed(int children) { return children <= LIST_MAX; }
+
+    uint8_t* list() { return reinterpret_cast<uint8_t*>(this); }
+    const uint8_t* list() const { return reinterpret_cast<const uint8_t*>(this); }
+    std::atomic<uint16_t>& list_bits(int which) const {
+        return *reinterpret_cast<std::atomic<uint16_t>*>(reinterpret_cast<uintptr_t>(this) + LIST_MAX + 2 * which);
+    }
+    std::atomic<uint64_t>* mask(int which) const {
+        return reinterpret_cast<std::atomic<uint64_t>*>(reinterpret_cast<uintptr_t>(this) + 32 * which);
+    }
+
+    int slot(uint8_t pattern) const {
+        for (int i = 0; i < LIST_MAX; i++)
+            if (list()[i] == pattern) return i;
+        return -1;
+    }
+
+    bool test(int which, uint8_t pattern, int children) const {
+        if (listed(children)) {
+            int i = slot(pattern);
+            return i >= 0 && (list_bits(which).load(std::memory_order_relaxed) >> i & 1);
+        }
+        return mask(which)[pattern >> 6].load(std::memory_order_relaxed) >> (pattern & 63) & 1;
+    }
+
+    // True only for the call that actually set the bit, so each child gets counted once however many threads race
+    bool set(int which, uint8_t pattern, int children) {
+        if (listed(children)) {
+            int i = slot(pattern);
+            if (i < 0) return false;
+            uint16_t bit = static_cast<uint16_t>(1u << i);
+            return !(list_bits(which).fetch_or(bit, std::memory_order_relaxed) & bit);
+        }
+        uint64_t bit = uint64_t(1) << (pattern & 63);
+        return !(mask(which)[pattern >> 6].fetch_or(bit, std::memory_order_relaxed) & bit);
+    }
+
+public:
+    static size_t bytes(int children) { return listed(children) ? 16 : 64; }
+
+    // Arena memory is zeroed, which is nothing solved yet. patterns are the entry's children, in any order.
+    // Alloc is the MemoryArena or anything else with its allocate()
+    template <typename Alloc>
+    static SolvedBuckets* create(Alloc& arena, const uint8_t* patterns, int children) {
+        SolvedBuckets* record = new (arena.allocate(bytes(children), 16)) SolvedBuckets;
+        if (listed(children))
+            for (int i = 0; i < children; i++) record->list()[i] = patterns[i];
+        return record;
+    }
+
+    bool solved(uint8_t pattern, int children) const { return test(SOLVED, pattern, children); }
+    bool mark(uint8_t pattern, int children) { return set(SOLVED, pattern, children); }
+
+    int count(int children) const {
+        if (listed(children)) return __builtin_popcount(list_bits(SOLVED).load(std::memory_order_relaxed));
+        int total = 0;
+        for (int w = 0; w < 4; w++) total += __builtin_popcountll(mask(SOLVED)[w].load(std::memory_order_relaxed));
+        return total;
+    }
+
+    // Whether the entry's Q has the child's V in it yet instead of what the heuristic assumed for it
+    bool synced(uint8_t pattern, int children) const { return test(SYNCED, pattern, children); }
+    bool sync(uint8_t pattern, int children) { return set(SYNCED, pattern, children); }
+};
+
+// Q data for one node, laid out as parallel arrays in a single arena block so selection scans contiguous q[].
+// Every field is an atomic updated in place, so there are no per entry locks. Each array starts on its own cache line
+struct alignas(64) QTable {
+    uint32_t num_actions;
+
+private:
+    static size_t line_up(size_t bytes) { return (bytes + 63) & ~size_t(63); }
+
+    static size_t q_offset() { return line_up(sizeof(QTable)); }
+    static size_t visit_offset(int n) { return q_offset() + line_up(n * sizeof(double)); }
+    static size_t total_offset(int n) { return visit_offset(n) + line_up(n * sizeof(uint32_t)); }
+    static size_t solved_offset(int n) { return total_offset(n) + line_up(n * sizeof(uint8_t)); }
+    static size_t record_offset(int n) { return solved_offset(n) + line_up(n * sizeof(uint8_t)); }
+    static size_t in_flight_offset(int n) { return record_offset(n) + line_up(n * sizeof(int32_t)); }
+
+    template <typename T>
+    T* array_at(size_t offset) const {
+        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(this) + offset);
+    }
+
+public:
+    static size_t bytes(int n) { return in_flight_offset(n) + line_up(n * sizeof(uint16_t)); }
+
+    // Arena memory is zeroed, and zero is a valid atomic, so only the count needs writing. Alloc is the MemoryArena
+    // or anything else with its allocate()
+    template <typename Alloc>
+    static QTable* create(Alloc& arena, int n) {
+        QTable* table = new (arena.allocate(bytes(n), 64)) QTable;
+        table->num_actions = n;
+        return table;
+    }
+
+    std::atomic<double>* q() const { return array_at<std::atomic<double>>(q_offset()); }                    // Expected guesses with this action
+    std::atomic<uint32_t>* visit_count() const { return array_at<std::atomic<uint32_t>>(visit_offset(num_actions)); }
+    std::atomic<uint8_t>* total_children() const { return array_at<std::atomic<uint8_t>>(total_offset(num_actions)); } // Number of offshoots, at most 243
+    std::atomic<uint8_t>* solved_children() const { return array_at<std::atomic<uint8_t>>(solved_offset(num_actions)); }
+
+    // Where each entry's SolvedBuckets is, in 16 byte units from the start of this table. 0 until it's made
+    std::atomic<int32_t>* records() const { return array_at<std::atomic<int32_t>>(record_offset(num_actions)); }
+
+    // Episodes walking through each entry right now, what virtual loss charges for. Always 0 with workers stopped,
+    // so copy() leaves it out
+    std::atomic<uint16_t>* in_flight() const { return array_at<std::atomic<uint16_t>>(in_flight_offset(num_actions)); }
+
+    SolvedBuckets* record(int i) const {
+        int32_t off = records()[i].load(std::memory_order_acquire);
+        return off ? array_at<SolvedBuckets>(static_cast<intptr_t>(off) * 16) : nullptr;
+    }
+
+    // Publishes record as entry i's unless another thread got one in first, returns whichever one stuck. The
+    // loser's 16 or 64 bytes just stay in the arena
+    SolvedBuckets* attach(int i, SolvedBuckets* record) {
+        intptr_t diff = static_cast<intptr_t>(reinterpret_cast<uintptr_t>(record) - reinterpret_cast<uintptr_t>(this)) / 16;
+        if (diff == 0 || diff != static_cast<int32_t>(diff)) throw std::runtime_error("SolvedBuckets out of reach of its QTable");
+        int32_t expected = 0;
+        if (records()[i].compare_exchange_strong(expected, static_cast<int32_t>(diff), std::memory_order_acq_rel))
+            return record;
+        return array_at<SolvedBuckets>(static_cast<intptr_t>(expected) * 16);
+    }
+
+    bool solved(int i) const {
+        uint8_t total = total_children()[i].load(std::memory_order_relaxed);
+        return total > 0 && solved_children()[i].load(std::memory_order_relaxed) == total;
+    }
+
+    // Copy of this table and its SolvedBuckets, for moving it out of memory that's about to be reclaimed. Only with
+    // nobody updating it
+    template <typename Alloc>
+    QTable* copy(Alloc& alloc) const {
+        QTable* table = create(alloc, num_actions);
+        std::memcpy(static_cast<void*>(table->q()), static_cast<const void*>(q()), record_offset(num_actions) - q_offset());
+        for (uint32_t i = 0; i < num_actions; i++) {
+            const SolvedBuckets* from = record(i);
+            if (!from) continue;
+            size_t bytes = SolvedBuckets::bytes(total_children()[i].load(std::memory_order_relaxed));
+            void* to = alloc.allocate(bytes, 16);
+            std::memcpy(to, static_cast<const void*>(from), bytes);
+            table->attach(i, static_cast<SolvedBuckets*>(to));
+        }
+        return table;
+    }
+};
+
+// Doubles have no fetch_add before C++20, and this is the only float atomic we need
+inline double atomic_add(std::atomic<double>& target, double delta, std::memory_order order = std::memory_order_relaxed) {
+    double old = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(old, old + delta, order, std::memory_order_relaxed)) {}
+    return old + delta;
+}
+
+// The state's key is stored right after the node in the arena instead of as a member: a sorted answer list
+// for small states (nearly all of them), or a full StateBitmap on the next 64 byte boundary for big ones.
+//
+// Solved states that are done changing are compact records: just the fields up to best_guess, COMPACT_BYTES.
+// A record for a state whose key is a list (up to COMPACT_KEY_MAX answers) doesn't keep the list, only
+// StateKey::check_hash() after it, RECORD_BYTES in all. The table's slot hash and that are 128 bits to match on,
+// and the record has no key() to give back. Bigger states keep their bitmap after the fields as full nodes do,
+// which is rare enough not to matter. The DP makes its solved states that way from the start, and Solver::compact
+// turns solved episode nodes into them. Nothing past best_guess exists in one, not even the lock, so anything
+// that may get handed one checks compact first
+struct StateNode {
+    // V, exactly the Q it came from. The backup swaps it with a single CAS, and the best action follows in its own
+    // word, see best below
+    std::atomic<double> value;
+    std::atomic<NodeStatus> status; // Acquire and release, so whoever sees Init sees the Q table behind it
+    bool compact;           // Set at creation, never changes
+
+    uint16_t key_size;      // Answers still possible in this state
+    uint16_t best_guess;    // Guess index behind v once it's solved, for reading the policy back out
+
+    // Full nodes only from here on
+
+    // The action behind V, with a 48 bit tag of the V it goes with. Whoever swapped V in publishes it right after,
+    // for as long as V is still theirs, so a stale one never sticks. One whose tag isn't V's is no action at all
+    std::atomic<uint64_t> best;
+
+    SpinLock lock;          // For changing status and V together outside the backup. Zero is unlocked, so restored nodes need no init
+
+    int num_actions;
+    RelPtr32<QTable> q_table;
+    RelPtr32<const ActionList> actions; // Guess index of each Q entry, shared with other nodes through the ActionPool
+
+    static constexpr size_t COMPACT_BYTES = 14;
+    static constexpr size_t CHECK_OFFSET = 16;  // Records of list keys, where the check hash goes
+    static constexpr size_t RECORD_BYTES = CHECK_OFFSET + sizeof(uint64_t);
+    static constexpr uint16_t NO_GUESS = 0xffff;
+    static constexpr uint16_t NO_ACTION = 0xffff;
+
+    static uint64_t best_word(double v, int action) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return ((bits * 0x9e3779b97f4a7c15ULL) & ~uint64_t(0xffff)) | static_cast<uint16_t>(action < 0 ? NO_ACTION : action);
+    }
+
+    double v() const { return value.load(std::memory_order_relaxed); }
+
+    // The action that gave V=v, -1 if none did or it isn't published yet
+    int best_for(double v) const {
+        if (compact) return -1;
+        uint64_t word = best.load();
+        uint16_t action = static_cast<uint16_t>(word);
+        return action == NO_ACTION || (word ^ best_word(v, -1)) >> 16 ? -1 : action;
+    }
+    int best_action() const { return best_for(v()); } // Which Q gives us that V?
+
+    // For whoever just swapped V to v. Gives up as soon as someone else's V is in
+    void publish_best(double v, int action) {
+        uint64_t next = best_word(v, action);
+        uint64_t word = best.load();
+        while (word != next && value.load() == v && !best.compare_exchange_weak(word, next)) {}
+    }
+
+    // Outside the backup, with the node locked or nobody else at it
+    void set_value(double v, int action) {
+        value.store(v, std::memory_order_relaxed);
+        if (!compact) best.store(best_word(v, action), std::memory_order_relaxed);
+    }
+
+    // Compact ones have it too, they're Solved for good
+    NodeStatus read_status() const { return status.load(std::memory_order_acquire); }
+    void set_status(NodeStatus now) { status.store(now, std::memory_order_release); }
+
+private:
+    explicit StateNode(int key_size)
+        : value(0.0), status(NodeStatus::None), compact(false), key_size(static_cast<uint16_t>(key_size)),
+          best_guess(NO_GUESS), best(best_word(0.0, -1)), num_actions(0) {}
+
+    static size_t key_offset(int key_size, bool compact) {
+        size_t offset = compact ? COMPACT_BYTES : sizeof(StateNode);
+        return StateKey::stores_compact(key_size) ? offset : (offset + 63) & ~size_t(63);
+    }
+
+    // Records of list keys keep the check hash instead
+    bool keeps_key() const { return !compact || !StateKey::stores_compact(key_size); }
+    uint64_t check() const {
+        uint64_t hash;
+        std::memcpy(&hash, reinterpret_cast<const std::byte*>(this) + CHECK_OFFSET, sizeof(hash));
+        return hash;
+    }
+
+public:
+    // From the arena or Generations, whatever alloc is. Generations is what lets Solver::compact free them again
+    template <typename Alloc>
+    static StateNode* create(Alloc& alloc, const StateKey& key) {
+        int size = key.size();
+        size_t align = StateKey::stores_compact(size) ? alignof(StateNode) : 64;
+        void* mem = alloc.allocate(full_bytes(size), align);
+
+        StateNode* node = new (mem) StateNode(size);
+        key.store(reinterpret_cast<std::byte*>(node) + key_offset(size, false));
+        return node;
+    }
+
+    static size_t full_bytes(int key_size) { return key_offset(key_size, false) + StateKey::storage_bytes(key_size); }
+    static size_t compact_bytes(int key_size) {
+        return StateKey::stores_compact(key_size) ? RECORD_BYTES : key_offset(key_size, true) + sizeof(StateBitmap);
+    }
+
+    // Arena memory is zeroed, so only the fields a compact node has get written, and nothing past them is touched
+    static StateNode* create_solved(MemoryArena& arena, const StateKey& key, double v, int best_guess) {
+        int size = key.size();
+        size_t align = StateKey::stores_compact(size) ? alignof(StateNode) : 64;
+        StateNode* node = static_cast<StateNode*>(arena.allocate(compact_bytes(size), align));
+
+        new (&node->value) std::atomic<double>(v);
+        new (&node->status) std::atomic<NodeStatus>(NodeStatus::Solved);
+        node->compact = true;
+        node->key_size = static_cast<uint16_t>(size);
+        node->best_guess = static_cast<uint16_t>(best_guess < 0 ? NO_GUESS : best_guess);
+        if (StateKey::stores_compact(size)) {
+            uint64_t hash = key.check_hash();
+            std::memcpy(reinterpret_cast<std::byte*>(node) + CHECK_OFFSET, &hash, sizeof(hash));
+        } else {
+            key.store(reinterpret_cast<std::byte*>(node) + key_offset(size, true));
+        }
+        return node;
+    }
+
+    // Not for a compact record of a list key, it doesn't have one. Solved nodes never get their key asked for
+    StateKey key() const {
+        if (!keeps_key()) throw std::runtime_error("Compact record of a small state has no key");
+        const std::byte* data = reinterpret_cast<const std::byte*>(this) + key_offset(key_size, compact);
+        if (StateKey::stores_compact(key_size))
+            return StateKey::from_list(reinterpret_cast<const uint16_t*>(data), key_size);
+        return StateKey::from_bitmap(*reinterpret_cast<const StateBitmap*>(data), key_size);
+    }
+
+    // Full check after a hash match in the table
+    bool matches(const StateKey& other) const {
+        if (!keeps_key()) return key_size == other.size() && check() == other.check_hash();
+        return key() == other;
+    }
+};
+
+static_assert(offsetof(StateNode, best_guess) + sizeof(uint16_t) == StateNode::COMPACT_BYTES,
+              "Compact nodes end right after best_guess");
+static_assert(StateNode::RECORD_BYTES < 32 && StateNode::CHECK_OFFSET >= StateNode::COMPACT_BYTES
+              && StateNode::CHECK_OFFSET % alignof(StateNode) == 0, "Records of list keys stay under 32 bytes");
@@ -0,0 +1,284 @@
+#include "Partition.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using GatherFn = void (*)(const uint8_t*, const int32_t*, int, uint8_t*);
+
+void gather_scalar(const uint8_t* lut_row, const int32_t* members, int count, uint8_t* out) {
+    for (int i = 0; i < count; i++)
+        out[i] = lut_row[members[i]];
+}
+
+// The gathers load 4 bytes starting at each answer's pattern and keep the low one.
+// That can read up to 3 bytes past the last answer, which is why the LUT rows are padded
+
+__attribute__((target("avx2")))
+void gather_avx2(const uint8_t* lut_row, const int32_t* members, int count, uint8_t* out) {
+    const __m256i low_bytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                               0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i join_lanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(members + i));
+        __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut_row), idx, 1);
+
+        // Pull byte 0 of each dword down, then bring the two lanes' 4 bytes together
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, low_bytes), join_lanes);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+    }
+    for (; i < count; i++)
+        out[i] = lut_row[members[i]];
+}
+
+__attribute__((target("avx512f")))
+void gather_avx512(const uint8_t* lut_row, const int32_t* members, int count, uint8_t* out) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512i idx = _mm512_loadu_si512(members + i);
+        __m512i words = _mm512_i32gather_epi32(idx, lut_row, 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm512_cvtepi32_epi8(words)); // Truncates to the low byte
+    }
+    for (; i < count; i++)
+        out[i] = lut_row[members[i]];
+}
+
+// Signature folding. hash_a is FNV-1a, hash_b a multiplicative hash with its own constants, over the same bytes
+constexpr uint32_t HASH_A_SEED = 2166136261u;
+constexpr uint32_t HASH_A_MUL = 16777619u;
+constexpr uint32_t HASH_B_SEED = 0x9e3779b9u;
+constexpr uint32_t HASH_B_ADD = 0x7f4a7c15u;
+constexpr uint32_t HASH_B_MUL = 0x85ebca77u;
+
+using FoldFn = void (*)(const uint8_t*, const uint8_t*, int, SignatureBlock&);
+
+void fold_scalar(const uint8_t* row, const uint8_t* first, int count, SignatureBlock& out) {
+    for (int g = 0; g < count; g++) {
+        uint8_t p = row[g];
+        out.hash_a[g] = (out.hash_a[g] ^ p) * HASH_A_MUL;
+        out.hash_b[g] = (out.hash_b[g] + p + HASH_B_ADD) * HASH_B_MUL;
+        out.split[g] |= p ^ first[g];
+        out.solved[g] |= p == PATTERN_SOLVED;
+        out.seen[p >> 6][g] |= uint64_t(1) << (p & 63);
+    }
+}
+
+// Both SIMD paths round count up to their width. The rows are padded to LUT_GUESS_STRIDE and the block arrays to
+// SIGNATURE_BLOCK, and lanes past the end never get read back
+
+__attribute__((target("avx2")))
+void flags_avx2(const uint8_t* row, const uint8_t* first, int count, SignatureBlock& out) {
+    const __m256i solved = _mm256_set1_epi8(static_cast<char>(PATTERN_SOLVED));
+    for (int g = 0; g < count; g += 32) {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + g));
+        __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + g));
+        __m256i* split = reinterpret_cast<__m256i*>(out.split.data() + g);
+        __m256i* hit = reinterpret_cast<__m256i*>(out.solved.data() + g);
+        _mm256_store_si256(split, _mm256_or_si256(_mm256_load_si256(split), _mm256_xor_si256(p, f)));
+        _mm256_store_si256(hit, _mm256_or_si256(_mm256_load_si256(hit), _mm256_cmpeq_epi8(p, solved)));
+    }
+}
+
+void mark_scalar(const uint8_t* row, int count, SignatureBlock& out) {
+    for (int g = 0; g < count; g++)
+        out.seen[row[g] >> 6][g] |= uint64_t(1) << (row[g] & 63);
+}
+
+// Picks each lane's word with compares, so every word gets written either way. Only pays off at 8 lanes, AVX2
+// sticks with mark_scalar
+__attribute__((target("avx512f")))
+void mark_avx512(const uint8_t* row, int count, SignatureBlock& out) {
+    const __m512i low = _mm512_set1_epi64(63);
+    const __m512i one = _mm512_set1_epi64(1);
+    for (int g = 0; g < count; g += 8) {
+        __m512i p = _mm512_cvtepu8_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + g)));
+        __m512i bit = _mm512_sllv_epi64(one, _mm512_and_si512(p, low));
+        __m512i word = _mm512_srli_epi64(p, 6);
+        for (int w = 0; w < 4; w++) {
+            uint64_t* seen = out.seen[w].data() + g;
+            __mmask8 hit = _mm512_cmpeq_epi64_mask(word, _mm512_set1_epi64(w));
+            _mm512_store_si512(seen, _mm512_mask_or_epi64(_mm512_load_si512(seen), hit, _mm512_load_si512(seen), bit));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void fold_avx2(const uint8_t* row, const uint8_t* first, int count, SignatureBlock& out) {
+    const __m256i mul_a = _mm256_set1_epi32(HASH_A_MUL);
+    const __m256i add_b = _mm256_set1_epi32(HASH_B_ADD);
+    const __m256i mul_b = _mm256_set1_epi32(HASH_B_MUL);
+    for (int g = 0; g < count; g += 8) {
+        __m256i p = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + g)));
+        __m256i* a = reinterpret_cast<__m256i*>(out.hash_a.data() + g);
+        __m256i* b = reinterpret_cast<__m256i*>(out.hash_b.data() + g);
+        _mm256_store_si256(a, _mm256_mullo_epi32(_mm256_xor_si256(_mm256_load_si256(a), p), mul_a));
+        _mm256_store_si256(b, _mm256_mullo_epi32(_mm256_add_epi32(_mm256_load_si256(b), _mm256_add_epi32(p, add_b)), mul_b));
+    }
+    flags_avx2(row, first, count, out);
+    mark_scalar(row, count, out);
+}
+
+__attribute__((target("avx512f")))
+void fold_avx512(const uint8_t* row, const uint8_t* first, int count, SignatureBlock& out) {
+    const __m512i mul_a = _mm512_set1_epi32(HASH_A_MUL);
+    const __m512i add_b = _mm512_set1_epi32(HASH_B_ADD);
+    const __m512i mul_b = _mm512_set1_epi32(HASH_B_MUL);
+    for (int g = 0; g < count; g += 16) {
+        __m512i p = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + g)));
+        uint32_t* a = out.hash_a.data() + g;
+        uint32_t* b = out.hash_b.data() + g;
+        _mm512_store_si512(a, _mm512_mullo_epi32(_mm512_xor_si512(_mm512_load_si512(a), p), mul_a));
+        _mm512_store_si512(b, _mm512_mullo_epi32(_mm512_add_epi32(_mm512_load_si512(b), _mm512_add_epi32(p, add_b)), mul_b));
+    }
+    flags_avx2(row, first, count, out); // Byte compares need BW at 512 bits, 256 does the flags just as well
+    mark_avx512(row, count, out);
+}
+
+void reset_block(SignatureBlock& out) {
+    out.hash_a.fill(HASH_A_SEED);
+    out.hash_b.fill(HASH_B_SEED);
+    out.split.fill(0);
+    out.solved.fill(0);
+    std::memset(out.seen.data(), 0, sizeof(out.seen));
+}
+
+FoldFn fold_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return fold_avx512;
+        case KernelIsa::AVX2: return fold_avx2;
+        default: return fold_scalar;
+    }
+}
+
+GatherFn gather_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return gather_avx512;
+        case KernelIsa::AVX2: return gather_avx2;
+        default: return gather_scalar;
+    }
+}
+
+KernelIsa detect_isa() {
+    __builtin_cpu_init(); // This runs during static init, possibly before libgcc has done it
+    if (kernel_isa_supported(KernelIsa::AVX512)) return KernelIsa::AVX512;
+    if (kernel_isa_supported(KernelIsa::AVX2)) return KernelIsa::AVX2;
+    return KernelIsa::Scalar;
+}
+
+KernelIsa current_isa = detect_isa();
+GatherFn current_gather = gather_for(current_isa);
+FoldFn current_fold = fold_for(current_isa);
+
+} // namespace
+
+bool kernel_isa_supported(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return __builtin_cpu_supports("avx512f");
+        case KernelIsa::AVX2: return __builtin_cpu_supports("avx2");
+        default: return true;
+    }
+}
+
+KernelIsa active_kernel_isa() {
+    return current_isa;
+}
+
+void set_kernel_isa(KernelIsa isa) {
+    if (!kernel_isa_supported(isa))
+        throw std::runtime_error(std::string("CPU doesn't support ") + kernel_isa_name(isa));
+    current_isa = isa;
+    current_gather = gather_for(isa);
+    current_fold = fold_for(isa);
+}
+
+const char* kernel_isa_name(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return "avx512";
+        case KernelIsa::AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+void gather_patterns(const uint8_t* lut_row, const int32_t* members, int count, uint8_t* out) {
+    current_gather(lut_row, members, count, out);
+}
+
+void partition_signatures(const PatternLUT& lut, const uint16_t* answers, int count, int guess_begin, SignatureBlock& out) {
+    int guesses = std::min(SIGNATURE_BLOCK, NUM_GUESSES - guess_begin);
+    reset_block(out);
+    if (count == 0) return;
+
+    const uint8_t* first = lut.answer_row(answers[0]) + guess_begin;
+    for (int i = 0; i < count; i++)
+        current_fold(lut.answer_row(answers[i]) + guess_begin, first, guesses, out);
+}
+
+void partition_signatures(const PatternLUT& lut, const uint16_t* answers, int count, const int32_t* guesses,
+                          int num_guesses, SignatureBlock& out) {
+    reset_block(out);
+    if (count == 0) return;
+
+    // The folds run over whole vectors, past num_guesses is garbage that nothing reads back
+    alignas(64) std::array<uint8_t, SIGNATURE_BLOCK> first;
+    alignas(64) std::array<uint8_t, SIGNATURE_BLOCK> row;
+    current_gather(lut.answer_row(answers[0]), guesses, num_guesses, first.data());
+    current_fold(first.data(), first.data(), num_guesses, out);
+    for (int i = 1; i < count; i++) {
+        current_gather(lut.answer_row(answers[i]), guesses, num_guesses, row.data());
+        current_fold(row.data(), first.data(), num_guesses, out);
+    }
+}
+
+void partition_state(const PatternLUT& lut, const StateKey& state, int guess, Partition& out) {
+    // Only clear what the last call used, most states only touch a handful of buckets
+    for (int b = 0; b < out.num_buckets; b++)
+        out.counts[out.patterns[b]] = 0;
+    out.num_buckets = 0;
+
+    // 1. Collect the members. Lists just widen, bitmaps go ctz over the words so empty words cost one compare
+    int count = state.size();
+    if (state.is_list()) {
+        const uint16_t* list = state.get_list();
+        for (int i = 0; i < count; i++) out.members[i] = list[i];
+    } else {
+        int i = 0;
+        for (int a : state.get_bitmap()) out.members[i++] = a;
+    }
+
+    // 2. Gather every member's pattern from the guess row
+    current_gather(lut.guess_row(guess), out.members.data(), count, out.member_patterns.data());
+
+    // 3. Bucket sizes
+    for (int i = 0; i < count; i++) {
+        uint8_t p = out.member_patterns[i];
+        if (out.counts[p]++ == 0)
+            out.patterns[out.num_buckets++] = p;
+    }
+
+    // 4. Counting sort into sorted[]. Members go in ascending, so each bucket comes out ascending
+    std::array<uint16_t, NUM_PATTERNS> cursor;
+    uint16_t start = 0;
+    for (int b = 0; b < out.num_buckets; b++) {
+        uint8_t p = out.patterns[b];
+        out.offsets[p] = cursor[p] = start;
+        start += out.counts[p];
+    }
+    for (int i = 0; i < count; i++)
+        out.sorted[cursor[out.member_patterns[i]]++] = static_cast<uint16_t>(out.members[i]);
+
+    // 5. Bitmaps for the few buckets that are too big for a list
+    for (int b = 0; b < out.num_buckets; b++) {
+        uint8_t p = out.patterns[b];
+        if (StateKey::stores_compact(out.counts[p])) continue;
+
+        out.children[p].reset();
+        for (int i = out.offsets[p]; i < out.offsets[p] + out.counts[p]; i++)
+            out.children[p].set(out.sorted[i]);
+    }
+}
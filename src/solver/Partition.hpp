@@ -0,0 +1,83 @@
+#pragma once
+#include "GameTypes.hpp"
+#include "PatternLUT.hpp"
+#include "StateKey.hpp"
+#include <array>
+#include <cstdint>
+
+// Which gather implementation the partition kernel runs. Picked once at startup from what the CPU supports
+enum class KernelIsa : uint8_t {
+    Scalar = 0,
+    AVX2 = 1,
+    AVX512 = 2
+};
+
+// Every child of a state under one guess. This is big (~90KB), so keep one per thread and reuse it.
+// Only the buckets listed in patterns[] are valid, everything else is guaranteed empty
+struct Partition {
+    std::array<uint16_t, NUM_PATTERNS> counts;
+    std::array<uint16_t, NUM_PATTERNS> offsets; // Where each bucket starts in sorted
+
+    std::array<uint8_t, NUM_PATTERNS> patterns; // Nonempty buckets, in order of first appearance
+    int num_buckets;
+
+    // Members grouped by bucket, still ascending inside each one, so every bucket is already a compact key
+    alignas(64) std::array<uint16_t, NUM_ANSWERS> sorted;
+
+    // Only built for buckets too big for a compact key
+    std::array<StateBitmap, NUM_PATTERNS> children;
+
+    // Scratch for the kernel, padded so the SIMD paths never need a tail check on the store side
+    alignas(64) std::array<int32_t, NUM_ANSWERS + 16> members;
+    alignas(64) std::array<uint8_t, NUM_ANSWERS + 64> member_patterns;
+
+    Partition() : counts{}, num_buckets(0) {}
+
+    StateKey child(uint8_t pattern) const {
+        if (StateKey::stores_compact(counts[pattern]))
+            return StateKey::from_list(&sorted[offsets[pattern]], counts[pattern]);
+        return StateKey::from_bitmap(children[pattern], counts[pattern]);
+    }
+};
+
+constexpr int SIGNATURE_BLOCK = 1024;
+
+// Partition signatures for a block of consecutive guesses, filled by partition_signatures. Two guesses that give
+// every answer the same pattern get the same signature. It's two independent 32 bit hashes so the SIMD paths
+// only need 32 bit multiplies. About 42KB, keep one per thread
+struct SignatureBlock {
+    alignas(64) std::array<uint32_t, SIGNATURE_BLOCK> hash_a;
+    alignas(64) std::array<uint32_t, SIGNATURE_BLOCK> hash_b;
+    alignas(64) std::array<uint8_t, SIGNATURE_BLOCK> split;  // Nonzero if two answers got different patterns
+    alignas(64) std::array<uint8_t, SIGNATURE_BLOCK> solved; // Nonzero if one of the answers is this guess
+    alignas(64) std::array<std::array<uint64_t, SIGNATURE_BLOCK>, 4> seen; // Patterns each guess produced, [word][guess]
+
+    uint64_t signature(int i) const { return static_cast<uint64_t>(hash_a[i]) << 32 | hash_b[i]; }
+
+    // Nonempty buckets other than the solved one, the children an expansion makes
+    int children(int i) const {
+        int count = 0;
+        for (const auto& word : seen) count += __builtin_popcountll(word[i]);
+        return count - (solved[i] ? 1 : 0);
+    }
+};
+
+// Signatures of guesses [guess_begin, guess_begin + SIGNATURE_BLOCK) over sorted answers, clipped at NUM_GUESSES.
+// Streams the answer major rows, so every answer is one contiguous pass over the block instead of a gather per guess
+void partition_signatures(const PatternLUT& lut, const uint16_t* answers, int count, int guess_begin, SignatureBlock& out);
+
+// Same for an arbitrary list of up to SIGNATURE_BLOCK guesses, entry i of out is guesses[i]. Each answer's row
+// gets gathered instead of streamed, so it only pays off when the list is a small part of all the guesses
+void partition_signatures(const PatternLUT& lut, const uint16_t* answers, int count, const int32_t* guesses,
+                          int num_guesses, SignatureBlock& out);
+
+// Splits state into all 243 pattern buckets under guess in one pass over its members. Works on either key form
+void partition_state(const PatternLUT& lut, const StateKey& state, int guess, Partition& out);
+
+// Looks up the pattern of each answer in members against one LUT row
+void gather_patterns(const uint8_t* lut_row, const int32_t* members, int count, uint8_t* out);
+
+KernelIsa active_kernel_isa();
+bool kernel_isa_supported(KernelIsa isa);
+void set_kernel_isa(KernelIsa isa); // For benchmarking, throws if the CPU can't run it
+const char* kernel_isa_name(KernelIsa isa);
@@ -0,0 +1,297 @@
+#include "Partitioned.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <omp.h>
+#include <sched.h>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+static_assert(std::is_trivially_copyable_v<PartitionStats>, "Reports go over the wire as is");
+
+constexpr uint64_t RANK_ARENA_MB = 8192;
+
+// Descend is token, key size and the key in its stored form. Result is token, V and solved
+constexpr size_t DESCEND_BYTES = sizeof(uint64_t) + sizeof(uint16_t);
+constexpr size_t RESULT_BYTES = sizeof(uint64_t) + sizeof(double) + sizeof(uint8_t);
+
+template <typename T>
+T read_at(const std::byte*& at) {
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    at += sizeof(T);
+    return value;
+}
+
+template <typename T>
+std::byte* write_at(std::byte* at, const T& value) {
+    std::memcpy(at, &value, sizeof(T));
+    return at + sizeof(T);
+}
+
+} // namespace
+
+PartitionedSolver::PartitionedSolver(Solver& solver, Transport& transport, const PartitionConfig& config)
+    : solver(solver), transport(transport), config(config), outboxes(transport.ranks()) {
+    stats.rank = transport.rank();
+}
+
+void PartitionedSolver::put(int to, Kind kind, const void* payload, size_t bytes) {
+    Outbox& box = outboxes[to];
+    if (box.batch.size() + 1 + bytes > transport.max_batch()) ship(to);
+    if (box.messages == 0) box.since = omp_get_wtime();
+    box.batch.push_back(static_cast<std::byte>(kind));
+    const std::byte* from = static_cast<const std::byte*>(payload);
+    box.batch.insert(box.batch.end(), from, from + bytes);
+    if (++box.messages >= config.batch_messages) ship(to);
+}
+
+void PartitionedSolver::ship(int to) {
+    Outbox& box = outboxes[to];
+    if (!box.messages) return;
+    transport.send(to, box.batch);
+    box.messages = 0;
+}
+
+// all sends every batch with anything in it, which is what a rank does when it has nothing else to do
+void PartitionedSolver::ship_due(bool all) {
+    double now = omp_get_wtime();
+    for (int to = 0; to < transport.ranks(); to++) {
+        const Outbox& box = outboxes[to];
+        if (box.messages && (all || (now - box.since) * 1000.0 >= config.max_delay_ms)) ship(to);
+    }
+}
+
+// Sends the walk's leaf to its owner and holds the walk until the Result
+void PartitionedSolver::park(Parked&& walk) {
+    StateKey key = walk.walk.leaf->key();
+    int owner = Solver::owner_of(key.hash(), transport.ranks());
+
+    static thread_local std::vector<std::byte> message;
+    message.resize(DESCEND_BYTES + StateKey::storage_bytes(key.size()));
+    std::byte* at = write_at(message.data(), next_token);
+    at = write_at(at, static_cast<uint16_t>(key.size()));
+    alignas(64) StateBitmap bitmap; // Bitmap form has to be stored aligned
+    if (StateKey::stores_compact(key.size())) {
+        key.store(at);
+    } else {
+        key.store(&bitmap);
+        std::memcpy(at, &bitmap, sizeof(StateBitmap));
+    }
+    put(owner, Kind::Descend, message.data(), message.size());
+
+    if (walk.origin < 0) own_parked++;
+    parked.emplace(next_token++, std::move(walk));
+    stats.parked++;
+    stats.descends_sent++;
+}
+
+void PartitionedSolver::reply(int to, uint64_t token, StateNode* node) {
+    std::byte message[RESULT_BYTES];
+    std::byte* at = write_at(message, token);
+    at = write_at(at, node->v());
+    write_at(at, static_cast<uint8_t>(node->read_status() == NodeStatus::Solved));
+    put(to, Kind::Result, message, sizeof(message));
+    stats.results_sent++;
+}
+
+void PartitionedSolver::handle(int from, const std::vector<std::byte>& batch) {
+    const std::byte* at = batch.data();
+    const std::byte* end = at + batch.size();
+    while (at < end) {
+        Kind kind = static_cast<Kind>(read_at<uint8_t>(at));
+        switch (kind) {
+            case Kind::Descend: {
+                uint64_t token = read_at<uint64_t>(at);
+                int size = read_at<uint16_t>(at);
+                static thread_local std::vector<uint16_t> list;
+                alignas(64) StateBitmap bitmap;
+                StateKey key = StateKey::from_list(nullptr, 0);
+                if (StateKey::stores_compact(size)) {
+                    list.resize(size);
+                    std::memcpy(list.data(), at, size * sizeof(uint16_t));
+                    key = StateKey::from_list(list.data(), size);
+                } else {
+                    std::memcpy(&bitmap, at, sizeof(StateBitmap));
+                    key = StateKey::from_bitmap(bitmap, size);
+                }
+                at += StateKey::storage_bytes(size);
+
+                StateNode* node = solver.get_or_create_node(key);
+                Parked walk{Solver::Walk(), from, token};
+                solver.walk(walk.walk, NUM_ANSWERS + 1, node);
+                stats.served++;
+                if (walk.walk.pending_remote) {
+                    park(std::move(walk));
+                } else {
+                    solver.finish(walk.walk);
+                    reply(from, token, node);
+                }
+                break;
+            }
+            case Kind::Result: {
+                uint64_t token = read_at<uint64_t>(at);
+                double v = read_at<double>(at);
+                bool solved = read_at<uint8_t>(at);
+                auto it = parked.find(token);
+                if (it == parked.end()) throw std::runtime_error("Result for a walk that isn't parked");
+                Parked walk = std::move(it->second);
+                parked.erase(it);
+
+                solver.finish_remote(walk.walk, v, solved);
+                if (walk.origin < 0) {
+                    own_parked--;
+                    stats.episodes++;
+                } else {
+                    reply(walk.origin, walk.origin_token, walk.walk.trajectory[0].node); // Where its walk started
+                }
+                break;
+            }
+            case Kind::Done:
+                done_heard++;
+                break;
+            case Kind::Report:
+                reports.push_back(read_at<PartitionStats>(at));
+                break;
+            default:
+                throw std::runtime_error("Unknown message from rank " + std::to_string(from));
+        }
+    }
+}
+
+void PartitionedSolver::start_episode() {
+    Parked walk{Solver::Walk(), -1, 0};
+    solver.walk(walk.walk, NUM_ANSWERS + 1);
+    if (walk.walk.pending_remote) {
+        park(std::move(walk));
+        return;
+    }
+    solver.finish(walk.walk);
+    stats.episodes++;
+}
+
+/**
+ * run - Runs this rank's episodes and serves other ranks' until every rank is done
+ * @returns This rank's counters, and its share of the root
+ */
+PartitionStats PartitionedSolver::run() {
+    double start = omp_get_wtime();
+    solver.shard_root();
+
+    long started = 0;
+    bool said_done = false;
+    int from;
+    std::vector<std::byte> batch;
+    while (true) {
+        bool worked = false;
+        while (transport.receive(from, batch)) {
+            handle(from, batch);
+            worked = true;
+        }
+        if (started < config.episodes && own_parked < config.max_pending) {
+            start_episode();
+            started++;
+            worked = true;
+        }
+        ship_due(!worked);
+        if (worked) continue;
+
+        if (!said_done && started == config.episodes && own_parked == 0) {
+            said_done = true;
+            done_heard++;
+            for (int to = 0; to < transport.ranks(); to++)
+                if (to != transport.rank()) put(to, Kind::Done, nullptr, 0);
+            ship_due(true);
+        }
+        if (said_done && done_heard == transport.ranks() && transport.drained()) break;
+        sched_yield(); // Waiting on other ranks, which may share this core
+    }
+
+    const StateNode* root = solver.get_root();
+    int best = root->best_action();
+    stats.share_v = root->v();
+    stats.share_guess = best >= 0 ? root->actions->guesses()[best] : -1;
+    stats.left_parked = static_cast<long>(parked.size());
+    solver.get_table().for_each([&](const StateNode* node) {
+        stats.nodes++;
+        if (node->compact) return;
+        if (node->read_status() == NodeStatus::Remote) stats.remote_nodes++;
+        if (!node->q_table) return;
+        for (int a = 0; a < node->num_actions; a++) stats.left_in_flight += node->q_table->in_flight()[a].load();
+    });
+    const Transport::Stats& sent = transport.stats();
+    stats.batches_sent = sent.batches_sent;
+    stats.bytes_sent = sent.bytes_sent;
+    stats.stalls = sent.stalls;
+    stats.ms = (omp_get_wtime() - start) * 1000.0;
+    return stats;
+}
+
+std::vector<PartitionStats> PartitionedSolver::gather() {
+    int from;
+    std::vector<std::byte> batch;
+    if (transport.rank() != 0) {
+        put(0, Kind::Report, &stats, sizeof(stats));
+        ship(0);
+        while (!transport.drained()) {
+            transport.receive(from, batch); // Retries the send, nothing else should be arriving
+            sched_yield();
+        }
+        return {};
+    }
+
+    while (static_cast<int>(reports.size()) < transport.ranks() - 1) {
+        if (transport.receive(from, batch)) handle(from, batch);
+        else sched_yield();
+    }
+    std::vector<PartitionStats> all(transport.ranks());
+    all[0] = stats;
+    for (const PartitionStats& report : reports) all[report.rank] = report;
+    return all;
+}
+
+std::vector<PartitionStats> solve_partitioned(const Wordle& wordle, Transport& transport, long episodes) {
+    SolverConfig config;
+    config.rank = transport.rank();
+    config.ranks = transport.ranks();
+    config.seed += transport.rank();
+    MemoryArena arena(RANK_ARENA_MB);
+    Solver solver(wordle, arena, config);
+
+    PartitionConfig partition;
+    partition.episodes = episodes;
+    PartitionedSolver ranked(solver, transport, partition);
+    ranked.run();
+    return ranked.gather();
+}
+
+/**
+ * run_partition_rank - One rank of a partitioned solve, what --partition-dir runs
+ * @param dir - Where every rank's socket goes, the same for all of them
+ * @param episodes - This rank's own
+ * @returns Exit code for the process
+ */
+int run_partition_rank(const Wordle& wordle, const std::string& dir, int rank, int ranks, long episodes) {
+    if (rank < 0 || rank >= ranks) {
+        fprintf(stderr, "Rank %d out of range for %d ranks\n", rank, ranks);
+        return 1;
+    }
+    UnixSocketTransport transport(dir, rank, ranks);
+    std::vector<PartitionStats> all = solve_partitioned(wordle, transport, episodes);
+    if (rank != 0) return 0;
+
+    double best = 0.0;
+    int guess = -1;
+    for (const PartitionStats& s : all) {
+        printf("rank %d: %ld episodes, %ld parked, %ld served, %lu nodes (%lu remote), share V %.4f in %.0f ms\n", s.rank,
+               s.episodes, s.parked, s.served, s.nodes, s.remote_nodes, s.share_v, s.ms);
+        if (guess < 0 || s.share_v < best) {
+            best = s.share_v;
+            guess = s.share_guess;
+        }
+    }
+    printf("root V %.4f, best guess #%d\n", best, guess);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "Solver.hpp"
+#include "Transport.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Solving across ranks that each hold part of the tree, for when the tree outgrows one machine.
+//
+// The state hash space is split into one range per rank, and a rank's table only keeps nodes for states in its
+// range, plus a Remote stand-in for each state of another rank its walks reach. Each rank walks its own share of
+// the root's guesses (Solver::shard_root). A walk that reaches another rank's state stops and parks, and a Descend
+// message sends the state to its owner. The owner carries the episode on from there as a walk of its own, which
+// can park in turn if it crosses into a third rank. Once that's backed up, a Result message carries the state's new
+// V and status back, and the parked walk backs up with it as the leaf value. The stand-in keeps the value for walks
+// that get there later, and a solved one ends them right there. Parked walks keep their entries in flight, so
+// virtual loss steers the next walks elsewhere meanwhile. States at or under dp_threshold get solved by whichever
+// rank reaches them, a round trip costs more than the DP.
+//
+// Messages to a rank are batched. A batch goes when it's full, when its oldest message has waited max_delay_ms,
+// or when this rank runs out of local work. A rank stops starting episodes at max_pending parked ones.
+// Ranks run their own episodes, then tell everyone with Done and keep serving until they've heard it from every
+// rank. Every message is part of some rank's unfinished episode, so after that nothing is left anywhere.
+//
+// One thread per rank for now, the rank is the unit of parallelism
+struct PartitionConfig {
+    long episodes = 1000;           // This rank's own
+    int max_pending = 64;           // Own episodes parked on other ranks before this one stops starting more
+    int batch_messages = 32;        // Messages to one rank that send the batch right away
+    double max_delay_ms = 2.0;      // Longest a message waits for its batch to fill
+};
+
+struct PartitionStats {
+    int rank = 0;
+    long episodes = 0;
+    long parked = 0;                // Walks that stopped on another rank's state, own episodes and served ones
+    long served = 0;                // Descends carried on here for another rank
+    long descends_sent = 0;
+    long results_sent = 0;
+    uint64_t batches_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t stalls = 0;
+    uint64_t nodes = 0;             // In this rank's table, its own and stand-ins
+    uint64_t remote_nodes = 0;      // Stand-ins
+    long left_in_flight = 0;        // 0 once run() is back
+    long left_parked = 0;
+    double share_v = 0.0;           // Best V over this rank's share of root guesses
+    int share_guess = -1;
+    double ms = 0.0;
+};
+
+class PartitionedSolver {
+    enum class Kind : uint8_t { Descend = 1, Result = 2, Done = 3, Report = 4 };
+
+    // A walk waiting on another rank. origin is the rank whose Descend started it, -1 for this rank's own episode
+    struct Parked {
+        Solver::Walk walk;
+        int origin;
+        uint64_t origin_token;
+    };
+
+    struct Outbox {
+        std::vector<std::byte> batch;
+        int messages = 0;
+        double since = 0.0;         // When the oldest message went in
+    };
+
+    Solver& solver;
+    Transport& transport;
+    PartitionConfig config;
+
+    std::unordered_map<uint64_t, Parked> parked;
+    uint64_t next_token = 1;
+    long own_parked = 0;
+    std::vector<Outbox> outboxes;   // Per rank
+    int done_heard = 0;
+    std::vector<PartitionStats> reports;
+    PartitionStats stats;
+
+    void put(int to, Kind kind, const void* payload, size_t bytes);
+    void ship(int to);
+    void ship_due(bool all);
+    void park(Parked&& walk);
+    void reply(int to, uint64_t token, StateNode* node);
+    void handle(int from, const std::vector<std::byte>& batch);
+    void start_episode();
+
+public:
+    PartitionedSolver(Solver& solver, Transport& transport, const PartitionConfig& config = PartitionConfig());
+
+    // This rank's episodes, and serving everyone else's until they're all done
+    PartitionStats run();
+
+    // Every rank's stats in rank order on rank 0, empty on the others. After run()
+    std::vector<PartitionStats> gather();
+};
+
+// What --partition-dir runs: one rank over a UnixSocketTransport in dir. Rank 0 prints the totals
+int run_partition_rank(const Wordle& wordle, const std::string& dir, int rank, int ranks, long episodes);
+
+// One rank's whole solve on a transport that's already up, the same config whoever calls it. Gathered stats on rank 0
+std::vector<PartitionStats> solve_partitioned(const Wordle& wordle, Transport& transport, long episodes);
@@ -0,0 +1,184 @@
+#include "PatternLUT.hpp"
+#include "Numa.hpp"
+#include "Wordle.hpp"
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// 64 x 64 tiles are 4KB, so the tile plus the rows it reads stay in L1 while it gets written out both ways
+constexpr int TILE = 64;
+
+struct LUTFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_guesses;
+    uint32_t num_answers;
+    uint32_t guess_stride;
+    uint32_t answer_stride;
+    uint32_t reserved;
+    uint64_t words_hash;  // Hash of the word lists this was built from
+    uint64_t checksum;    // Hash of both tables
+};
+
+constexpr char LUT_MAGIC[8] = {'M', 'C', 'D', 'P', 'L', 'U', 'T', '\0'};
+
+constexpr size_t GUESS_MAJOR_BYTES = static_cast<size_t>(NUM_GUESSES) * LUT_ANSWER_STRIDE;
+constexpr size_t ANSWER_MAJOR_BYTES = static_cast<size_t>(NUM_ANSWERS) * LUT_GUESS_STRIDE;
+
+constexpr size_t PAGE_BYTES = 4096;
+
+size_t round_to_page(size_t bytes) {
+    return (bytes + PAGE_BYTES - 1) & ~(PAGE_BYTES - 1);
+}
+
+} // namespace
+
+PatternLUT::PatternLUT()
+    : guess_major(alloc_table(GUESS_MAJOR_BYTES)), answer_major(alloc_table(ANSWER_MAJOR_BYTES)) {}
+
+PatternLUT::AlignedBuffer PatternLUT::alloc_table(size_t bytes) {
+    // Page aligned so the pages can be placed with mbind, aligned_alloc wants the size rounded to match
+    void* p = std::aligned_alloc(PAGE_BYTES, round_to_page(bytes));
+    if (!p) throw std::bad_alloc();
+    std::memset(p, 0, bytes); // Padding has to be deterministic for the checksum
+    return AlignedBuffer(static_cast<uint8_t*>(p));
+}
+
+void PatternLUT::build(const std::vector<std::string>& guesses, const std::vector<std::string>& answers) {
+    if (guesses.size() != NUM_GUESSES || answers.size() != NUM_ANSWERS)
+        throw std::runtime_error("PatternLUT word lists don't match NUM_GUESSES / NUM_ANSWERS");
+
+    constexpr int guess_tiles = (NUM_GUESSES + TILE - 1) / TILE;
+    constexpr int answer_tiles = (NUM_ANSWERS + TILE - 1) / TILE;
+
+    #pragma omp parallel for collapse(2) schedule(dynamic)
+    for (int gt = 0; gt < guess_tiles; ++gt) {
+        for (int at = 0; at < answer_tiles; ++at) {
+            uint8_t tile[TILE][TILE];
+
+            int g0 = gt * TILE, a0 = at * TILE;
+            int g_count = std::min(TILE, NUM_GUESSES - g0);
+            int a_count = std::min(TILE, NUM_ANSWERS - a0);
+
+            for (int g = 0; g < g_count; ++g)
+                for (int a = 0; a < a_count; ++a)
+                    tile[g][a] = Wordle::compute_pattern(guesses[g0 + g], answers[a0 + a]);
+
+            // Guess major write, rows of the tile
+            for (int g = 0; g < g_count; ++g)
+                std::memcpy(&guess_major[static_cast<size_t>(g0 + g) * LUT_ANSWER_STRIDE + a0], tile[g], a_count);
+
+            // Answer major write, columns of the tile
+            for (int a = 0; a < a_count; ++a) {
+                uint8_t* row = &answer_major[static_cast<size_t>(a0 + a) * LUT_GUESS_STRIDE + g0];
+                for (int g = 0; g < g_count; ++g)
+                    row[g] = tile[g][a];
+            }
+        }
+    }
+}
+
+uint64_t PatternLUT::checksum(const uint8_t* guess_table, const uint8_t* answer_table) {
+    uint64_t h = hash_bytes(guess_table, GUESS_MAJOR_BYTES);
+    return hash_bytes(answer_table, ANSWER_MAJOR_BYTES, h);
+}
+
+void PatternLUT::interleave_pages() {
+    numa_interleave(guess_major.get(), round_to_page(GUESS_MAJOR_BYTES));
+    numa_interleave(answer_major.get(), round_to_page(ANSWER_MAJOR_BYTES));
+}
+
+uint64_t PatternLUT::hash_words(const std::vector<std::string>& guesses, const std::vector<std::string>& answers) {
+    uint64_t h = mix64(guesses.size()) ^ mix64(answers.size() + 1);
+    for (const auto& word : guesses) h = hash_bytes(word.data(), word.size(), h);
+    for (const auto& word : answers) h = hash_bytes(word.data(), word.size(), h);
+    return h;
+}
+
+bool PatternLUT::save(const std::string& path, uint64_t words_hash) const {
+    LUTFileHeader header{};
+    std::memcpy(header.magic, LUT_MAGIC, sizeof(LUT_MAGIC));
+    header.version = LUT_FILE_VERSION;
+    header.num_guesses = NUM_GUESSES;
+    header.num_answers = NUM_ANSWERS;
+    header.guess_stride = LUT_GUESS_STRIDE;
+    header.answer_stride = LUT_ANSWER_STRIDE;
+    header.words_hash = words_hash;
+    header.checksum = checksum(guess_major.get(), answer_major.get());
+
+    // Write to a temp file and rename, so a crash mid-write never leaves a half file that looks valid
+    std::string tmp_path = path + ".tmp";
+    FILE* f = std::fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1
+           && std::fwrite(guess_major.get(), 1, GUESS_MAJOR_BYTES, f) == GUESS_MAJOR_BYTES
+           && std::fwrite(answer_major.get(), 1, ANSWER_MAJOR_BYTES, f) == ANSWER_MAJOR_BYTES;
+    ok = (std::fclose(f) == 0) && ok;
+
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PatternLUT::load(const std::string& path, uint64_t words_hash) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    LUTFileHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, f) == 1
+           && std::memcmp(header.magic, LUT_MAGIC, sizeof(LUT_MAGIC)) == 0
+           && header.version == LUT_FILE_VERSION
+           && header.num_guesses == NUM_GUESSES
+           && header.num_answers == NUM_ANSWERS
+           && header.guess_stride == LUT_GUESS_STRIDE
+           && header.answer_stride == LUT_ANSWER_STRIDE
+           && header.words_hash == words_hash;
+
+    if (!ok) {
+        std::fclose(f);
+        return false;
+    }
+
+    // Read into scratch tables so a bad file can't clobber a good LUT
+    AlignedBuffer new_guess_major = alloc_table(GUESS_MAJOR_BYTES);
+    AlignedBuffer new_answer_major = alloc_table(ANSWER_MAJOR_BYTES);
+
+    ok = std::fread(new_guess_major.get(), 1, GUESS_MAJOR_BYTES, f) == GUESS_MAJOR_BYTES
+      && std::fread(new_answer_major.get(), 1, ANSWER_MAJOR_BYTES, f) == ANSWER_MAJOR_BYTES;
+    std::fclose(f);
+
+    if (!ok || checksum(new_guess_major.get(), new_answer_major.get()) != header.checksum)
+        return false;
+
+    guess_major = std::move(new_guess_major);
+    answer_major = std::move(new_answer_major);
+    return true;
+}
+
+void PatternLUT::load_or_build(const std::string& path, const std::vector<std::string>& guesses, const std::vector<std::string>& answers) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t words_hash = hash_words(guesses, answers);
+
+    if (!path.empty() && load(path, words_hash)) {
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+        printf("Loaded pattern LUT from %s in %.1f ms\n", path.c_str(), ms.count());
+        return;
+    }
+
+    build(guesses, answers);
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+    printf("Built pattern LUT in %.1f ms\n", ms.count());
+
+    if (!path.empty() && !save(path, words_hash))
+        fprintf(stderr, "WARNING: Couldn't write the pattern LUT cache to %s\n", path.c_str());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "GameTypes.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Rows get padded out to a cache line multiple, so every row starts aligned and SIMD loads can run a bit past the end
+constexpr int LUT_ANSWER_STRIDE = (NUM_ANSWERS + 63) & ~63; // Row length of the guess major table
+constexpr int LUT_GUESS_STRIDE = (NUM_GUESSES + 63) & ~63;  // Row length of the answer major table
+
+// Bump this whenever the file layout or the pattern encoding changes
+constexpr uint32_t LUT_FILE_VERSION = 1;
+
+class PatternLUT {
+    struct FreeDeleter {
+        void operator()(uint8_t* p) const { std::free(p); }
+    };
+    using AlignedBuffer = std::unique_ptr<uint8_t[], FreeDeleter>;
+
+    AlignedBuffer guess_major;  // [guess * LUT_ANSWER_STRIDE + answer], used for partitioning a state by one guess
+    AlignedBuffer answer_major; // [answer * LUT_GUESS_STRIDE + guess], used for sweeping every guess over one answer
+
+    static AlignedBuffer alloc_table(size_t bytes);
+    static uint64_t checksum(const uint8_t* guess_table, const uint8_t* answer_table);
+
+public:
+    PatternLUT();
+
+    // Full rebuild with cache blocked tiles, both layouts get written from the same tile while it's hot
+    void build(const std::vector<std::string>& guesses, const std::vector<std::string>& answers);
+
+    // Binary cache. load returns false (and leaves the tables alone) if the file is missing, stale, or corrupt
+    bool load(const std::string& path, uint64_t words_hash);
+    bool save(const std::string& path, uint64_t words_hash) const;
+
+    // What startup should actually call
+    void load_or_build(const std::string& path, const std::vector<std::string>& guesses, const std::vector<std::string>& answers);
+
+    // Spreads both tables' pages over every NUMA node, since every thread reads them. No-op on one node
+    void interleave_pages();
+
+    // Ties a cache file to the exact word lists it was built from
+    static uint64_t hash_words(const std::vector<std::string>& guesses, const std::vector<std::string>& answers);
+
+    uint8_t get(int guess, int answer) const {
+        return guess_major[static_cast<size_t>(guess) * LUT_ANSWER_STRIDE + answer];
+    }
+
+    const uint8_t* guess_row(int guess) const {
+        return guess_major.get() + static_cast<size_t>(guess) * LUT_ANSWER_STRIDE;
+    }
+
+    const uint8_t* answer_row(int answer) const {
+        return answer_major.get() + static_cast<size_t>(answer) * LUT_GUESS_STRIDE;
+    }
+};
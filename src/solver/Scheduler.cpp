@@ -0,0 +1,125 @@
+#include "Scheduler.hpp"
+#include "Numa.hpp"
+
+#include <immintrin.h>
+#include <mutex>
+#include <omp.h>
+
+namespace {
+
+void add(EpisodeStats& total, const EpisodeStats& walk) {
+    total.sum_depth += walk.sum_depth;
+    total.iterations += walk.iterations;
+    total.expansions += walk.expansions;
+    total.expand_candidates += walk.expand_candidates;
+    total.actions_kept += walk.actions_kept;
+    total.actions_pruned += walk.actions_pruned;
+    total.expand_ms += walk.expand_ms;
+    total.rewalks += walk.rewalks;
+}
+
+} // namespace
+
+EpisodeScheduler::EpisodeScheduler(Solver& solver, const SchedulerConfig& config) : solver(solver), config(config) {}
+
+void EpisodeScheduler::push(int worker, const Solver::Walk& walk) {
+    TaskQueue& queue = queues[worker];
+    std::lock_guard<SpinLock> guard(queue.lock);
+    queue.tasks.push_back(walk);
+    queue.size.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool EpisodeScheduler::pop(int worker, Solver::Walk& walk) {
+    TaskQueue& queue = queues[worker];
+    if (!queue.size.load(std::memory_order_relaxed)) return false;
+    std::lock_guard<SpinLock> guard(queue.lock);
+    if (queue.tasks.empty()) return false;
+    walk = queue.tasks.back();
+    queue.tasks.pop_back();
+    queue.size.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Oldest first, those have held their entries in flight the longest. Victims go round from the thief's neighbor so
+// thieves don't all pile onto worker 0
+bool EpisodeScheduler::steal(int thief, int workers, Solver::Walk& walk) {
+    for (int i = 1; i < workers; i++) {
+        TaskQueue& queue = queues[(thief + i) % workers];
+        if (!queue.size.load(std::memory_order_relaxed) || !queue.lock.try_lock()) continue;
+        bool took = !queue.tasks.empty();
+        if (took) {
+            walk = queue.tasks.front();
+            queue.tasks.pop_front();
+            queue.size.fetch_sub(1, std::memory_order_relaxed);
+        }
+        queue.lock.unlock();
+        if (took) return true;
+    }
+    return false;
+}
+
+/**
+ * run - Walks and backs up episodes on every worker until the count is done
+ * @param episodes - How many to run, each is claimed by whichever worker gets to it first
+ * @returns Totals over every worker
+ */
+SchedulerStats EpisodeScheduler::run(long episodes) {
+    SchedulerStats stats;
+    double start = omp_get_wtime();
+    int team = config.threads > 0 ? config.threads : omp_get_max_threads();
+    queues = std::make_unique<TaskQueue[]>(team);
+    bool pin = config.numa && team != pinned_team;
+
+    std::atomic<long> claimed{0};
+    std::atomic<long> finished{0};
+    SpinLock stats_lock;
+
+    #pragma omp parallel num_threads(team)
+    {
+        int me = omp_get_thread_num();
+        int workers = omp_get_num_threads();
+        if (pin) numa_pin_thread(me);
+        SchedulerStats mine;
+        Solver::Walk walk;
+
+        while (true) {
+            int pending = queues[me].size.load(std::memory_order_relaxed);
+            if (pending >= config.max_pending && pop(me, walk)) {
+                solver.finish(walk);
+            } else if (pending == 0 && steal(me, workers, walk)) {
+                solver.finish(walk);
+                mine.stolen++;
+            } else if (claimed.load(std::memory_order_relaxed) < episodes
+                       && claimed.fetch_add(1, std::memory_order_relaxed) < episodes) {
+                add(mine.walks, solver.walk(walk, config.handoff_min));
+                if (walk.pending_dp) {
+                    push(me, walk);
+                    mine.handoffs++;
+                    continue; // Not finished yet
+                }
+                solver.finish(walk);
+            } else if (pop(me, walk)) {
+                solver.finish(walk); // Nothing left to walk, drain
+            } else if (steal(me, workers, walk)) {
+                solver.finish(walk);
+                mine.stolen++;
+            } else {
+                if (finished.load(std::memory_order_acquire) >= episodes) break;
+                _mm_pause(); // Others are still finishing what they have
+                continue;
+            }
+            mine.episodes++;
+            finished.fetch_add(1, std::memory_order_release);
+        }
+
+        std::lock_guard<SpinLock> guard(stats_lock);
+        stats.episodes += mine.episodes;
+        stats.handoffs += mine.handoffs;
+        stats.stolen += mine.stolen;
+        add(stats.walks, mine.walks);
+    }
+
+    if (pin) pinned_team = team;
+    stats.ms = (omp_get_wtime() - start) * 1000.0;
+    return stats;
+}
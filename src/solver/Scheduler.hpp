@@ -0,0 +1,56 @@
+#pragma once
+#include "Solver.hpp"
+#include "SpinLock.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+struct SchedulerConfig {
+    int threads = 0;            // Team size, OpenMP's default when 0
+    int handoff_min = 10;       // Walks stopping on a DP state at least this big leave it as a task anyone can take
+    int max_pending = 2;        // A worker keeps walking until it has this many of its own tasks waiting
+    bool numa = false;          // Pin worker i to node i % nodes, whatever size the team is
+};
+
+struct SchedulerStats {
+    long episodes = 0;
+    long handoffs = 0;          // Walks that left their DP as a task
+    long stolen = 0;            // Tasks finished by a worker other than the one that walked them
+    double ms = 0.0;
+    EpisodeStats walks;         // Summed over every walk, handed off DPs aren't in them
+};
+
+// Runs episodes on a team of workers with no barrier anywhere in between. Workers claim episodes off a shared
+// count and walk them back to back. A walk that ends on a big DP state goes on its worker's queue as a task, and the
+// worker walks on. Its entries stay in flight meanwhile, so virtual loss keeps the next walks off that path.
+// A worker takes its own tasks newest first once it has max_pending of them, and one with none steals the oldest
+// task from someone else before starting a walk.
+//
+// The workers are the OpenMP team, which is what the NUMA pinning, the arena slabs and the per thread RNGs and
+// scratch already key on, and OpenMP keeps the threads around between runs. The team can be bigger than the default
+// one main() pinned, so with numa set the workers pin themselves whenever the team size changes. run() only returns
+// once every task is finished, so nothing is in flight between calls and reclaim, compact and checkpoints can go there
+class EpisodeScheduler {
+    // The owner's end is the back
+    struct alignas(64) TaskQueue {
+        SpinLock lock;
+        std::deque<Solver::Walk> tasks;
+        std::atomic<int> size{0};   // Peeked at without the lock
+    };
+
+    Solver& solver;
+    SchedulerConfig config;
+    std::unique_ptr<TaskQueue[]> queues;
+    int pinned_team = 0;        // Team size the workers were last pinned for, OpenMP reuses the threads while it holds
+
+    void push(int worker, const Solver::Walk& walk);
+    bool pop(int worker, Solver::Walk& walk);
+    bool steal(int thief, int workers, Solver::Walk& walk);
+
+public:
+    EpisodeScheduler(Solver& solver, const SchedulerConfig& config = SchedulerConfig());
+
+    // Runs that many episodes and returns once all of them are backed up. Not reentrant
+    SchedulerStats run(long episodes);
+};
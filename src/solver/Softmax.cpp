@@ -0,0 +1,278 @@
+#include "Softmax.hpp"
+#include "Partition.hpp"
+
+#include <immintrin.h>
+
+namespace {
+
+using MinFn = double (*)(const double*, const uint8_t*, const uint8_t*, int);
+using WeightsFn = void (*)(const double*, const uint8_t*, const uint8_t*, int, double, float, float*, float*);
+
+// Anything at or above this is a solved entry, never a real Q
+constexpr double SOLVED_Q = 1e30;
+
+// Cephes expf constants. exp(x) = 2^n * exp(f) with n = round(x / ln2), so |f| <= ln2 / 2
+constexpr float EXP_MIN = -87.0f; // Below this 2^n underflows the exponent bits
+constexpr float LOG2E = 1.44269504f;
+constexpr float LN2_HI = 0.693359375f; // ln2 split in two so x - n * ln2 keeps its precision
+constexpr float LN2_LO = -2.12194440e-4f;
+constexpr float EXP_P[] = {1.98756912e-4f, 1.39819994e-3f, 8.33345205e-3f, 4.16657962e-2f, 1.66666672e-1f, 5.0e-1f};
+
+// exp for x <= 0, accurate to a few ulp in float
+inline float fast_exp(float x) {
+    x = x < EXP_MIN ? EXP_MIN : x;
+    float n = __builtin_nearbyintf(x * LOG2E);
+    float f = x - n * LN2_HI - n * LN2_LO;
+
+    float p = EXP_P[0];
+    for (int i = 1; i < 6; i++) p = p * f + EXP_P[i];
+    p = p * f * f + f + 1.0f;
+
+    int bits = (static_cast<int>(n) + 127) << 23;
+    float scale;
+    __builtin_memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+inline bool entry_solved(uint8_t total, uint8_t solved) {
+    return total > 0 && solved == total;
+}
+
+// The Q arrays are atomics, but a plain load of an aligned double or byte can't tear, and a slightly stale Q
+// is fine for sampling. Reading them as plain arrays is what lets the kernels use vector loads
+
+double min_q_scalar(const double* q, const uint8_t* total, const uint8_t* solved, int n) {
+    double best = SOLVED_Q;
+    for (int i = 0; i < n; i++)
+        if (!entry_solved(total[i], solved[i]) && q[i] < best) best = q[i];
+    return best;
+}
+
+// Weights are exp((q_min - q) / temp), shifted by the best Q so the top weight is 1 and nothing overflows.
+// Solved entries get 0. Each SOFTMAX_BLOCK weights also get summed into block_sums
+void weights_scalar(const double* q, const uint8_t* total, const uint8_t* solved, int n,
+                    double q_min, float inv_temp, float* weights, float* block_sums) {
+    for (int start = 0; start < n; start += SOFTMAX_BLOCK) {
+        int end = start + SOFTMAX_BLOCK < n ? start + SOFTMAX_BLOCK : n;
+        float sum = 0.0f;
+        for (int i = start; i < end; i++) {
+            float w = entry_solved(total[i], solved[i]) ? 0.0f : fast_exp(static_cast<float>(q_min - q[i]) * inv_temp);
+            weights[i] = w;
+            sum += w;
+        }
+        block_sums[start / SOFTMAX_BLOCK] = sum;
+    }
+}
+
+// The vector kernels run whole chunks and leave the last partial one to the scalar code
+
+__attribute__((target("avx2")))
+inline __m256i solved_lanes_avx2(const uint8_t* total, const uint8_t* solved) {
+    __m128i t = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(total));
+    __m128i s = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(solved));
+    __m128i done = _mm_andnot_si128(_mm_cmpeq_epi8(t, _mm_setzero_si128()), _mm_cmpeq_epi8(t, s));
+    return _mm256_cvtepi8_epi32(done); // 0xff bytes widen to all ones lanes
+}
+
+__attribute__((target("avx2")))
+inline __m256 load_q_avx2(const double* q) {
+    __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(q));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(q + 4));
+    return _mm256_set_m128(hi, lo);
+}
+
+__attribute__((target("avx2")))
+double min_q_avx2(const double* q, const uint8_t* total, const uint8_t* solved, int n) {
+    __m256d best = _mm256_set1_pd(SOLVED_Q);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i done = solved_lanes_avx2(total + i, solved + i);
+        __m256d lo = _mm256_blendv_pd(_mm256_loadu_pd(q + i), best,
+                                      _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(done))));
+        __m256d hi = _mm256_blendv_pd(_mm256_loadu_pd(q + i + 4), best,
+                                      _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(done, 1))));
+        best = _mm256_min_pd(best, _mm256_min_pd(lo, hi));
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, best);
+    double result = min_q_scalar(q + i, total + i, solved + i, n - i);
+    for (double lane : lanes) result = lane < result ? lane : result;
+    return result;
+}
+
+__attribute__((target("avx2")))
+inline __m256 exp_avx2(__m256 x) {
+    x = _mm256_max_ps(x, _mm256_set1_ps(EXP_MIN));
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 f = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(LN2_HI)));
+    f = _mm256_sub_ps(f, _mm256_mul_ps(n, _mm256_set1_ps(LN2_LO)));
+
+    __m256 p = _mm256_set1_ps(EXP_P[0]);
+    for (int k = 1; k < 6; k++) p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP_P[k]));
+    p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, f), f), f), _mm256_set1_ps(1.0f));
+
+    __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx2")))
+void weights_avx2(const double* q, const uint8_t* total, const uint8_t* solved, int n,
+                  double q_min, float inv_temp, float* weights, float* block_sums) {
+    const __m256 min = _mm256_set1_ps(static_cast<float>(q_min));
+    const __m256 scale = _mm256_set1_ps(inv_temp);
+
+    int full = n / SOFTMAX_BLOCK * SOFTMAX_BLOCK;
+    for (int start = 0; start < full; start += SOFTMAX_BLOCK) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int i = start; i < start + SOFTMAX_BLOCK; i += 8) {
+            __m256 w = exp_avx2(_mm256_mul_ps(_mm256_sub_ps(min, load_q_avx2(q + i)), scale));
+            w = _mm256_andnot_ps(_mm256_castsi256_ps(solved_lanes_avx2(total + i, solved + i)), w);
+            _mm256_storeu_ps(weights + i, w);
+            sum = _mm256_add_ps(sum, w);
+        }
+
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_movehdup_ps(half));
+        block_sums[start / SOFTMAX_BLOCK] = _mm_cvtss_f32(half);
+    }
+    weights_scalar(q + full, total + full, solved + full, n - full, q_min, inv_temp, weights + full,
+                   block_sums + full / SOFTMAX_BLOCK);
+}
+
+__attribute__((target("avx512f")))
+inline __mmask16 solved_lanes_avx512(const uint8_t* total, const uint8_t* solved) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(total));
+    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(solved));
+    __m128i done = _mm_andnot_si128(_mm_cmpeq_epi8(t, _mm_setzero_si128()), _mm_cmpeq_epi8(t, s));
+    return static_cast<__mmask16>(_mm_movemask_epi8(done));
+}
+
+__attribute__((target("avx512f")))
+double min_q_avx512(const double* q, const uint8_t* total, const uint8_t* solved, int n) {
+    __m512d best = _mm512_set1_pd(SOLVED_Q);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 live = ~solved_lanes_avx512(total + i, solved + i);
+        best = _mm512_mask_min_pd(best, static_cast<__mmask8>(live), best, _mm512_loadu_pd(q + i));
+        best = _mm512_mask_min_pd(best, static_cast<__mmask8>(live >> 8), best, _mm512_loadu_pd(q + i + 8));
+    }
+    double tail = min_q_scalar(q + i, total + i, solved + i, n - i);
+    double result = _mm512_reduce_min_pd(best);
+    return tail < result ? tail : result;
+}
+
+__attribute__((target("avx512f")))
+void weights_avx512(const double* q, const uint8_t* total, const uint8_t* solved, int n,
+                    double q_min, float inv_temp, float* weights, float* block_sums) {
+    const __m512 min = _mm512_set1_ps(static_cast<float>(q_min));
+    const __m512 scale = _mm512_set1_ps(inv_temp);
+
+    int full = n / SOFTMAX_BLOCK * SOFTMAX_BLOCK;
+    for (int start = 0; start < full; start += SOFTMAX_BLOCK) {
+        __m512 sum = _mm512_setzero_ps();
+        for (int i = start; i < start + SOFTMAX_BLOCK; i += 16) {
+            __m256 lo = _mm512_cvtpd_ps(_mm512_loadu_pd(q + i));
+            __m256 hi = _mm512_cvtpd_ps(_mm512_loadu_pd(q + i + 8));
+            __m512 q16 = _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(lo)),
+                                                             _mm256_castps_pd(hi), 1));
+            __m512 x = _mm512_max_ps(_mm512_mul_ps(_mm512_sub_ps(min, q16), scale), _mm512_set1_ps(EXP_MIN));
+
+            __m512 nn = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)), _MM_FROUND_TO_NEAREST_INT);
+            __m512 f = _mm512_fnmadd_ps(nn, _mm512_set1_ps(LN2_HI), x);
+            f = _mm512_fnmadd_ps(nn, _mm512_set1_ps(LN2_LO), f);
+
+            __m512 p = _mm512_set1_ps(EXP_P[0]);
+            for (int k = 1; k < 6; k++) p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(EXP_P[k]));
+            p = _mm512_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(p, f), f, f), _mm512_set1_ps(1.0f));
+
+            // scalef multiplies by 2^n directly, no exponent bit twiddling needed
+            __m512 w = _mm512_maskz_scalef_ps(~solved_lanes_avx512(total + i, solved + i), p, nn);
+            _mm512_storeu_ps(weights + i, w);
+            sum = _mm512_add_ps(sum, w);
+        }
+        block_sums[start / SOFTMAX_BLOCK] = _mm512_reduce_add_ps(sum);
+    }
+    weights_scalar(q + full, total + full, solved + full, n - full, q_min, inv_temp, weights + full,
+                   block_sums + full / SOFTMAX_BLOCK);
+}
+
+// Follows the partition kernel's ISA, so set_kernel_isa switches both
+MinFn min_q_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return min_q_avx512;
+        case KernelIsa::AVX2: return min_q_avx2;
+        default: return min_q_scalar;
+    }
+}
+
+WeightsFn weights_for(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512: return weights_avx512;
+        case KernelIsa::AVX2: return weights_avx2;
+        default: return weights_scalar;
+    }
+}
+
+// One draw from weights already filled in
+int draw(const float* weights, const float* block_sums, int n, float sum, Rng& rng) {
+    int num_blocks = (n + SOFTMAX_BLOCK - 1) / SOFTMAX_BLOCK;
+
+    // Walk the block sums, then the weights inside the block the draw lands in
+    float r = static_cast<float>(rng.uniform()) * sum;
+    int b = 0;
+    for (; b < num_blocks - 1 && r >= block_sums[b]; b++)
+        r -= block_sums[b];
+
+    int start = b * SOFTMAX_BLOCK;
+    int end = start + SOFTMAX_BLOCK < n ? start + SOFTMAX_BLOCK : n;
+    int last_valid = -1;
+    for (int i = start; i < end; i++) {
+        if (weights[i] == 0.0f) continue;
+        last_valid = i;
+        if (r < weights[i]) return i;
+        r -= weights[i];
+    }
+
+    // Float rounding can leave r just past the end of the block
+    if (last_valid >= 0) return last_valid;
+    for (int i = n - 1; i >= 0; i--)
+        if (weights[i] > 0.0f) return i;
+    return -1;
+}
+
+} // namespace
+
+int softmax_select(const QTable& table, double temperature, Rng& rng, SoftmaxScratch& scratch, double virtual_loss) {
+    int n = table.num_actions;
+    if (n == 0) return -1;
+
+    const double* q = reinterpret_cast<const double*>(table.q());
+    const uint8_t* total = reinterpret_cast<const uint8_t*>(table.total_children());
+    const uint8_t* solved = reinterpret_cast<const uint8_t*>(table.solved_children());
+
+    KernelIsa isa = active_kernel_isa();
+    double q_min = min_q_for(isa)(q, total, solved, n);
+    if (q_min >= SOLVED_Q) return -1; // Everything is solved
+
+    int num_blocks = (n + SOFTMAX_BLOCK - 1) / SOFTMAX_BLOCK;
+    if ((int)scratch.weights.size() < n) scratch.weights.resize(n);
+    if ((int)scratch.block_sums.size() < num_blocks) scratch.block_sums.resize(num_blocks);
+
+    float* weights = scratch.weights.data();
+    float* block_sums = scratch.block_sums.data();
+    weights_for(isa)(q, total, solved, n, q_min, static_cast<float>(1.0 / temperature), weights, block_sums);
+
+    float sum = 0.0f;
+    for (int b = 0; b < num_blocks; b++) sum += block_sums[b];
+
+    int pick = draw(weights, block_sums, n, sum, rng);
+    if (virtual_loss <= 0.0) return pick;
+    for (int draws = 1; pick >= 0 && draws < MAX_DRAWS; draws++) {
+        uint16_t busy = table.in_flight()[pick].load(std::memory_order_relaxed);
+        if (!busy || rng.uniform() < fast_exp(static_cast<float>(-busy * virtual_loss / temperature))) break;
+        pick = draw(weights, block_sums, n, sum, rng);
+    }
+    return pick;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Nodes.hpp"
+#include "Rng.hpp"
+#include <vector>
+
+// Reused per thread so selection never allocates
+struct SoftmaxScratch {
+    std::vector<float> weights;
+    std::vector<float> block_sums; // Sum of each SOFTMAX_BLOCK weights, lets the draw skip whole blocks
+};
+
+constexpr int SOFTMAX_BLOCK = 64;
+constexpr int MAX_DRAWS = 8;
+
+// Samples an action with probability proportional to exp(-q / temperature), never picking a solved one.
+// Returns -1 when every action is solved.
+// With a virtual_loss, each episode in flight through an entry counts as that much more Q. The kernels don't see
+// it: a draw that lands on a busy entry is only kept with the odds the extra Q works out to, otherwise it's drawn
+// again, which comes to the same distribution. After MAX_DRAWS the last one stands
+int softmax_select(const QTable& table, double temperature, Rng& rng, SoftmaxScratch& scratch, double virtual_loss = 0.0);
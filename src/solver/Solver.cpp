@@ -0,0 +1,847 @@
+#include "Solver.hpp"
+#include "Softmax.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <omp.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Per thread buffers for expand, sized for the root once so they never grow
+struct ExpandScratch {
+    static constexpr int SET_BITS = 15; // Room for every guess at under half load
+
+    std::vector<uint16_t> answers;
+    std::vector<int32_t> members;       // answers widened for gather_patterns, with its tail padding
+    std::vector<int32_t> candidates;
+    std::vector<uint64_t> signatures;   // Per slot, which is a guess or a gathered candidate
+    std::vector<uint8_t> split;
+    std::vector<uint8_t> solved;
+    std::vector<uint8_t> children;
+    std::vector<uint16_t> kept;
+    std::vector<int> kept_at;           // Slot of each kept guess
+
+    // Signatures seen this expansion, open addressing. A slot only counts if its stamp is this round's
+    std::vector<uint64_t> set;
+    std::vector<uint32_t> set_round;
+    uint32_t round = 0;
+
+    ExpandScratch()
+        : members(NUM_ANSWERS + 16), signatures(NUM_GUESSES), split(NUM_GUESSES), solved(NUM_GUESSES), children(NUM_GUESSES),
+          set(1 << SET_BITS), set_round(1 << SET_BITS, 0) {
+        answers.reserve(NUM_ANSWERS);
+        candidates.reserve(NUM_GUESSES);
+        kept.reserve(NUM_GUESSES);
+        kept_at.reserve(NUM_GUESSES);
+    }
+
+    // False if signature was already in the set
+    bool insert(uint64_t signature) {
+        uint32_t mask = (1u << SET_BITS) - 1;
+        for (uint32_t i = static_cast<uint32_t>(signature >> 17) & mask; ; i = (i + 1) & mask) {
+            if (set_round[i] != round) {
+                set_round[i] = round;
+                set[i] = signature;
+                return true;
+            }
+            if (set[i] == signature) return false;
+        }
+    }
+};
+
+// Sizes of every bucket but the solved one, the way Heuristic wants them
+const BucketCounts& bucket_counts(const Partition& partition) {
+    static thread_local BucketCounts buckets{};
+    buckets.counts.fill(0);
+    for (int b = 0; b < partition.num_buckets; b++) {
+        uint8_t p = partition.patterns[b];
+        if (p != PATTERN_SOLVED) buckets.counts[p] = partition.counts[p];
+    }
+    return buckets;
+}
+
+ExpandScratch& expand_scratch() {
+    static thread_local std::unique_ptr<ExpandScratch> scratch = std::make_unique<ExpandScratch>();
+    return *scratch;
+}
+
+} // namespace
+
+Solver::Solver(const Wordle& wordle, MemoryArena& arena, const SolverConfig& config)
+    : wordle(wordle), arena(arena), config(config), persisted(find_roots(arena)),
+      table(arena, config.table_size_exp, persisted ? persisted->table : 0),
+      action_pool(arena, config.action_pool_size_exp, persisted ? persisted->action_pool : 0),
+      generations(arena), node_blocks(arena), keep_visits(config.keep_visits),
+      dp(wordle.get_lut(), arena, table, config.dp_parallel_min),
+      heuristic(config.heuristic, INITIAL_V, config.curve_a, config.curve_b) {
+    if (persisted) {
+        root = arena.at<StateNode>(persisted->root);
+        return;
+    }
+
+    StateBitmap all_answers = StateBitmap::full();
+    root = get_or_create_node(StateKey::from_bitmap(all_answers, NUM_ANSWERS));
+
+    persisted = new (arena.allocate(sizeof(SolverRoots), 64))
+        SolverRoots{table.offset(), action_pool.offset(), arena.offset_of(root)};
+    arena.set_root(ARENA_ROOT, arena.offset_of(persisted));
+}
+
+SolverRoots* Solver::find_roots(MemoryArena& arena) {
+    uint64_t off = arena.get_root(ARENA_ROOT);
+    return off ? arena.at<SolverRoots>(off) : nullptr;
+}
+
+StateNode* Solver::get_or_create_node(const StateKey& state) {
+    return table.find_or_insert(state.hash(), state, [&] { return StateNode::create(node_blocks, state); });
+}
+
+Partition& Solver::thread_partition() {
+    static thread_local std::unique_ptr<Partition> partition = std::make_unique<Partition>(); // Too big for the stack
+    return *partition;
+}
+
+Rng& Solver::thread_rng() const {
+    // Reseeded whenever a thread starts working for a different solver, so runs replay per thread from config.seed
+    static thread_local const Solver* owner = nullptr;
+    static thread_local Rng rng;
+    if (owner != this) {
+        owner = this;
+        rng = Rng(config.seed, omp_get_thread_num());
+    }
+    return rng;
+}
+
+EpisodeStats Solver::run_episode() {
+    Walk walked;
+    EpisodeStats stats = walk(walked, NUM_ANSWERS + 1);
+    finish(walked);
+    return stats;
+}
+
+/**
+ * walk - An episode's way down, from the root to a solved node, the DP, or the depth limit
+ * @param out - Its trajectory and leaf value, for finish()
+ * @param handoff_min - DP leaves with at least this many answers are left pending instead of evaluated here
+ * @param start - Node to walk down from, the root if null
+ * @returns Counters for the walk. A pending DP isn't in them, it's not done yet
+ */
+EpisodeStats Solver::walk(Walk& out, int handoff_min, StateNode* start) {
+    EpisodeStats stats;
+    Step* trajectory = out.trajectory;
+    int& depth = out.depth;
+    depth = 0;
+
+    const PatternLUT& lut = wordle.get_lut();
+    Partition& partition = thread_partition();
+    Rng& rng = thread_rng();
+    static thread_local SoftmaxScratch softmax_scratch;
+
+    StateNode* current = start ? start : root;
+    double final_value = 0.0;
+    bool leaf_solved = false;   // Whether current is solved once the walk stops
+
+    while (true) {
+        stats.sum_depth++;
+
+        // Check terminated
+        if (current->read_status() == NodeStatus::Solved) {
+            if (depth > 0) arrive(trajectory[depth - 1], current);
+            final_value = current->v();
+            stats.rewalks++;
+            leaf_solved = true;
+            break;
+        }
+
+        // Check DP threshold
+        int remaining_states = current->key_size;
+        if (remaining_states <= config.dp_threshold) {
+            if (depth > 0) arrive(trajectory[depth - 1], current);
+            leaf_solved = true;
+            if (remaining_states >= handoff_min) {
+                out.leaf = current;
+                out.pending_dp = true;
+                break;
+            }
+            final_value = dp_evaluate_node(current);
+            if (depth > 0) reached(trajectory[depth - 1], final_value);
+            break;
+        }
+
+        // Another rank's, it carries on from here. Where the walk started is always this rank's
+        if (depth > 0 && config.ranks > 1 && (current->read_status() == NodeStatus::Remote || !owns(current->key()))) {
+            arrive(trajectory[depth - 1], current);
+            out.leaf = current;
+            out.pending_remote = true;
+            break;
+        }
+
+        // Expand empty nodes. An evicted one starts over from the heuristic, which moves its V
+        double reexpanded = 0.0;
+        NodeStatus status = current->read_status();
+        if (status == NodeStatus::None || status == NodeStatus::Evicted) {
+            const ActionList* inherited = nullptr;
+            if (config.inherit_actions && depth > 0) inherited = trajectory[depth - 1].node->actions.get();
+            ExpandStats expanded = expand(current, inherited);
+            if (expanded.answers) {
+                stats.expansions++;
+                stats.expand_candidates += expanded.candidates;
+                stats.actions_kept += expanded.kept;
+                stats.actions_pruned += NUM_GUESSES - expanded.kept;
+                stats.expand_ms += expanded.ms;
+                reexpanded = expanded.v_jump;
+            }
+        }
+        if (depth > 0) {
+            arrive(trajectory[depth - 1], current);
+            if (!trajectory[depth - 1].first) trajectory[depth - 1].jump = reexpanded; // Synced to the V it had before
+        }
+
+        // Softmax action selection
+        int chosen_index = -1;
+        if (current->num_actions)
+            chosen_index = softmax_select(*current->q_table, config.heuristic_temp, rng, softmax_scratch, config.virtual_loss);
+
+        if (chosen_index < 0 || depth == MAX_DEPTH) {
+            current->lock.lock();
+            if (chosen_index < 0) {
+                current->set_status(NodeStatus::Solved); // When all children are solved, the parent is solved
+                arena.mark_dirty(current, sizeof(StateNode));
+                leaf_solved = true;
+            }
+            final_value = current->v();
+            current->lock.unlock();
+            break;
+        }
+        int guess = current->actions->guesses()[chosen_index];
+
+        StateKey key = current->key();
+        partition_state(lut, key, guess, partition);
+        uint8_t pattern = choose_pattern(current, chosen_index, guess, key, partition, rng);
+
+        trajectory[depth].node = current;
+        trajectory[depth].action_ind = chosen_index;
+        trajectory[depth].weight = (double)partition.counts[pattern] / remaining_states;
+        trajectory[depth].pattern = pattern;
+        trajectory[depth].assumed = 0.0;
+        trajectory[depth].jump = 0.0;
+        trajectory[depth].first = false;
+        if (config.virtual_loss > 0.0) current->q_table->in_flight()[chosen_index].fetch_add(1, std::memory_order_relaxed);
+
+        if (pattern == PATTERN_SOLVED) {
+            // Guessed the answer, nothing left below this
+            depth++;
+            final_value = 0.0;
+            break;
+        }
+
+        StateNode* child = get_or_create_node(partition.child(pattern));
+
+        // Whatever this Q started out assuming for it, until an episode through the entry has synced the child
+        const QTable* q_table = current->q_table.get();
+        if (!q_table->record(chosen_index)->synced(pattern, q_table->total_children()[chosen_index].load(std::memory_order_relaxed))) {
+            bool hit = partition.counts[PATTERN_SOLVED] > 0;
+            Heuristic::Sums sums = heuristic.flat() ? Heuristic::Sums{} : heuristic.sums(bucket_counts(partition));
+            trajectory[depth].assumed = heuristic.child_value(sums, remaining_states, hit, partition.counts[pattern]);
+        }
+        depth++;
+
+        current = child;
+    }
+
+    out.final_value = final_value;
+    out.leaf_solved = leaf_solved;
+    return stats;
+}
+
+/**
+ * finish - Runs a walk's DP if it was left pending, then backs it up
+ * @param walk - From walk(), on this thread or any other
+ */
+void Solver::finish(Walk& walk) {
+    if (walk.pending_dp) {
+        walk.final_value = dp_evaluate_node(walk.leaf);
+        if (walk.depth > 0) reached(walk.trajectory[walk.depth - 1], walk.final_value);
+        walk.pending_dp = false;
+    }
+    propagate_update(walk.trajectory, walk.depth, walk.leaf_solved);
+}
+
+/**
+ * finish_remote - Backs up a walk whose leaf another rank owns
+ * @param walk - From walk(), with pending_remote set
+ * @param v - The leaf's V on its owner after it carried the episode on
+ * @param solved - Whether the owner has it solved
+ */
+void Solver::finish_remote(Walk& walk, double v, bool solved) {
+    StateNode* leaf = walk.leaf;
+    Step& step = walk.trajectory[walk.depth - 1];
+    leaf->lock.lock();
+    if (leaf->read_status() != NodeStatus::Solved) {
+        if (!step.first) step.jump = v - leaf->v(); // Just what this call moves it by, the entry has the rest
+        leaf->set_value(v, -1);
+        leaf->set_status(solved ? NodeStatus::Solved : NodeStatus::Remote);
+        arena.mark_dirty(leaf, sizeof(StateNode));
+    }
+    leaf->lock.unlock();
+    reached(step, v);
+
+    walk.final_value = v;
+    walk.leaf_solved = solved;
+    walk.pending_remote = false;
+    propagate_update(walk.trajectory, walk.depth, solved);
+}
+
+void Solver::shard_root() {
+    expand(root);
+    if (config.ranks <= 1) return;
+
+    constexpr double FOREIGN_Q = 1e9; // Past any real expected guess count, so V never takes it
+    QTable* q_table = root->q_table.get();
+    int best = -1;
+    for (int a = 0; a < root->num_actions; a++) {
+        if (a % config.ranks == config.rank) {
+            if (best < 0 || q_table->q()[a].load() < q_table->q()[best].load()) best = a;
+            continue;
+        }
+        q_table->q()[a].store(FOREIGN_Q);
+        q_table->total_children()[a].store(1);
+        q_table->solved_children()[a].store(1);
+    }
+    root->set_value(best >= 0 ? q_table->q()[best].load() : FOREIGN_Q, best);
+    arena.mark_dirty(q_table, QTable::bytes(root->num_actions));
+    arena.mark_dirty(root, sizeof(StateNode));
+}
+
+/**
+ * reclaim - One cycle of the bounded memory mode
+ * @returns What happened to the Q tables of the generation it released, and occupancy before and after
+ */
+ReclaimStats Solver::reclaim() {
+    ReclaimStats stats;
+    double start = omp_get_wtime();
+    stats.occupancy_before = occupancy();
+
+    int victim = generations.oldest();
+    generations.advance(); // So survivors land in fresh chunks, never in the ones being freed
+    stats.generation = victim;
+
+    table.for_each([&](StateNode* node) {
+        if (node->compact) return;
+        QTable* q_table = node->q_table.get();
+        if (!q_table || generations.generation_of(q_table) != victim) return;
+
+        uint64_t visits = 0;
+        for (int a = 0; a < node->num_actions; a++) visits += q_table->visit_count()[a].load(std::memory_order_relaxed);
+
+        if (node == root || node->key_size >= config.keep_answers || visits >= keep_visits) {
+            node->q_table = q_table->copy(generations);
+            stats.kept++;
+            stats.copied_bytes += QTable::bytes(node->num_actions);
+        } else if (node->read_status() == NodeStatus::Solved) {
+            node->q_table = nullptr; // num_actions and the action list stay, best_action still indexes it
+            stats.summarized++;
+        } else {
+            node->q_table = nullptr;
+            node->num_actions = 0;
+            node->set_value(node->v(), -1);
+            node->set_status(NodeStatus::Evicted);
+            stats.evicted++;
+        }
+        arena.mark_dirty(node, sizeof(StateNode));
+    });
+
+    stats.released_bytes = generations.release(victim);
+    stats.occupancy_after = occupancy();
+    stats.ms = (omp_get_wtime() - start) * 1000.0;
+    return stats;
+}
+
+std::vector<ReclaimStats> Solver::enforce_budget() {
+    std::vector<ReclaimStats> cycles;
+    if (!over_budget()) return cycles;
+
+    double target = config.low_water * (config.memory_budget_mb << 20);
+    constexpr int MAX_PASSES = 8;
+    for (int pass = 0; pass < MAX_PASSES && occupancy() > target; pass++) {
+        int last = generations.current();
+        while (occupancy() > target && generations.oldest() <= last) cycles.push_back(reclaim());
+        if (occupancy() > target) keep_visits *= 2;
+    }
+    return cycles;
+}
+
+/**
+ * compact - Summarizes solved subtrees down to the V and best guess of each of their nodes
+ * @returns How many nodes got summarized and what that freed
+ */
+CompactStats Solver::compact() {
+    CompactStats stats;
+    double start = omp_get_wtime();
+    stats.occupancy_before = occupancy();
+    size_t free_before = generations.free_bytes() + node_blocks.free_bytes();
+
+    // Chunks in the current generation never get released, so make sure none of them are
+    generations.advance();
+    node_blocks.advance();
+
+    table.rewrite([&](StateNode* node) {
+        if (node->compact || node == root || node->read_status() != NodeStatus::Solved) return node;
+
+        int best_guess = node->best_guess;
+        int best = node->best_action();
+        if (best >= 0 && best < node->num_actions) best_guess = node->actions->guesses()[best];
+        StateNode* record = StateNode::create_solved(arena, node->key(), node->v(), best_guess);
+        stats.compacted++;
+        stats.record_bytes += StateNode::compact_bytes(node->key_size);
+
+        if (QTable* q_table = node->q_table.get()) {
+            for (int a = 0; a < node->num_actions; a++) {
+                const SolvedBuckets* buckets = q_table->record(a);
+                if (!buckets) continue;
+                size_t bytes = SolvedBuckets::bytes(q_table->total_children()[a].load(std::memory_order_relaxed));
+                generations.free(buckets, bytes);
+                stats.freed_bytes += bytes;
+            }
+            generations.free(q_table, QTable::bytes(node->num_actions));
+            stats.freed_bytes += QTable::bytes(node->num_actions);
+        }
+        node_blocks.free(node, StateNode::full_bytes(node->key_size)); // A no-op for ones restored from a checkpoint
+        stats.freed_bytes += StateNode::full_bytes(node->key_size);
+        return record;
+    });
+
+    stats.occupancy_after = occupancy();
+    stats.released_bytes = generations.free_bytes() + node_blocks.free_bytes() - free_before;
+    stats.ms = (omp_get_wtime() - start) * 1000.0;
+    return stats;
+}
+
+int Solver::break_locks(uint32_t pid) {
+    int broken = 0;
+    table.for_each([&](StateNode* node) {
+        if (!node->compact && node->lock.break_held(pid)) broken++;
+    });
+    return broken;
+}
+
+void Solver::clear_in_flight() {
+    table.for_each([&](StateNode* node) {
+        if (node->compact || !node->q_table) return;
+        QTable* q_table = node->q_table.get();
+        for (int a = 0; a < node->num_actions; a++) q_table->in_flight()[a].store(0, std::memory_order_relaxed);
+    });
+}
+
+uint64_t Solver::abandon_claims(double settle_ms) {
+    std::vector<uint64_t> nodes = table.unpublished();
+    std::vector<uint64_t> lists = action_pool.unpublished();
+    if (nodes.empty() && lists.empty()) return 0;
+    if (settle_ms > 0.0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(settle_ms));
+    return table.abandon(nodes) + action_pool.abandon(lists);
+}
+
+/**
+ * choose_pattern - Picks the bucket this episode's answer falls in, which is the same as picking the answer
+ * @param node - Node the guess is taken from, its Q entry gets a SolvedBuckets the first time through
+ * @param action_ind - Q entry of the guess
+ * @param partition - The node's state split by the guess
+ * @returns A bucket that isn't solved yet, with odds by its size. Uniform over every answer if targeting is off
+ *          or nothing is left unsolved, which only happens when another thread solved the entry meanwhile
+ */
+uint8_t Solver::choose_pattern(StateNode* node, int action_ind, int guess, const StateKey& key, const Partition& partition,
+                               Rng& rng) {
+    QTable* q_table = node->q_table.get();
+    int children = q_table->total_children()[action_ind].load(std::memory_order_relaxed);
+    SolvedBuckets* record = q_table->record(action_ind);
+    if (!record) {
+        uint8_t patterns[NUM_PATTERNS];
+        int count = 0;
+        for (int b = 0; b < partition.num_buckets; b++)
+            if (partition.patterns[b] != PATTERN_SOLVED) patterns[count++] = partition.patterns[b];
+        record = q_table->attach(action_ind, SolvedBuckets::create(generations, patterns, count));
+        arena.mark_dirty(record, SolvedBuckets::bytes(count));
+        arena.mark_dirty(&q_table->records()[action_ind], sizeof(int32_t));
+    }
+
+    if (config.target_unsolved) {
+        uint32_t unsolved = 0;
+        for (int b = 0; b < partition.num_buckets; b++) {
+            uint8_t p = partition.patterns[b];
+            if (p != PATTERN_SOLVED && !record->solved(p, children)) unsolved += partition.counts[p];
+        }
+        if (unsolved) {
+            uint32_t nth = rng.below(unsolved);
+            for (int b = 0; b < partition.num_buckets; b++) {
+                uint8_t p = partition.patterns[b];
+                if (p == PATTERN_SOLVED || record->solved(p, children)) continue;
+                if (nth < partition.counts[p]) return p;
+                nth -= partition.counts[p];
+            }
+        }
+    }
+
+    int nth = rng.below(key.size());
+    int answer = key.is_list() ? key.get_list()[nth] : key.get_bitmap().select(nth);
+    return wordle.get_lut().get(guess, answer);
+}
+
+/**
+ * expand - A lot of the core of the algorithm, this is where we build and init the children of a node
+ * @param parent - Parent node to expand from
+ * @param inherited - Optional action list of a superset state to start from instead of every guess
+ * @returns What got pruned and how long it took, all zero if the node was already expanded
+ */
+ExpandStats Solver::expand(StateNode* parent, const ActionList* inherited) {
+    ExpandStats stats;
+    if (parent->compact) return stats; // Solved for good
+    parent->lock.lock();
+    NodeStatus status = parent->read_status();
+    if (status != NodeStatus::None && status != NodeStatus::Evicted) {
+        parent->lock.unlock();
+        return stats; // Another thread got the race condition and has already expanded
+    }
+
+    double start = omp_get_wtime();
+    const PatternLUT& lut = wordle.get_lut();
+    ExpandScratch& s = expand_scratch();
+
+    StateKey key = parent->key();
+    int n = key.size();
+    uint32_t letters = 0;
+    s.answers.clear();
+    key.for_each([&](int a) {
+        s.members[s.answers.size()] = a;
+        s.answers.push_back(static_cast<uint16_t>(a));
+        letters |= wordle.get_answer_letters(a);
+    });
+    stats.answers = n;
+
+    // 1. Candidates. With a superset's list, only its survivors: answers only ever get removed, so a guess that
+    //    split nothing there splits nothing here, and two guesses that matched on every answer there still match
+    //    on these. A guess with none of the letters still in play is all gray for every answer, so it's useless
+    //    too, and that's one AND instead of a signature
+    s.candidates.clear();
+    if (inherited) {
+        const uint16_t* guesses = inherited->guesses();
+        for (uint32_t i = 0; i < inherited->count; i++) {
+            if (wordle.get_guess_letters(guesses[i]) & letters)
+                s.candidates.push_back(guesses[i]);
+            else
+                stats.gray++;
+        }
+    }
+    int num_candidates = inherited ? static_cast<int>(s.candidates.size()) : NUM_GUESSES;
+    stats.candidates = num_candidates;
+
+    // 2. Signature and child count of every candidate, a block at a time. Streaming the answer major rows is one
+    //    contiguous pass per answer, gathering just the candidates costs about 1.5x that per guess. So a short
+    //    list gets gathered into slots of its own, a long one streams every guess and skips the rest afterwards.
+    //    Big states spread the blocks over threads, unless this is already one of many episodes in parallel
+    bool gather = inherited && num_candidates * 3 < NUM_GUESSES * 2;
+    bool spread = n >= config.expand_parallel_min && !omp_in_parallel();
+    int slots = gather ? num_candidates : NUM_GUESSES;
+    int blocks = (slots + SIGNATURE_BLOCK - 1) / SIGNATURE_BLOCK;
+    #pragma omp parallel for schedule(dynamic) if(spread)
+    for (int b = 0; b < blocks; b++) {
+        static thread_local std::unique_ptr<SignatureBlock> block = std::make_unique<SignatureBlock>();
+        int j0 = b * SIGNATURE_BLOCK;
+        int count = std::min(SIGNATURE_BLOCK, slots - j0);
+        if (gather)
+            partition_signatures(lut, s.answers.data(), n, s.candidates.data() + j0, count, *block);
+        else
+            partition_signatures(lut, s.answers.data(), n, j0, *block);
+
+        for (int i = 0; i < count; i++) {
+            s.signatures[j0 + i] = block->signature(i);
+            s.split[j0 + i] = block->split[i];
+            s.solved[j0 + i] = block->solved[i];
+            s.children[j0 + i] = static_cast<uint8_t>(block->children(i));
+        }
+    }
+
+    // 3. Prune. A guess that leaves everything in one bucket refines nothing, unless it's that one answer.
+    //    Guesses with the same signature give every answer the same pattern, so only the first one is kept.
+    //    Candidates are in guess order either way, so the kept list is the same as a full scan would give
+    s.kept.clear();
+    s.kept_at.clear();
+    s.round++;
+    for (int i = 0; i < num_candidates; i++) {
+        int g = inherited ? s.candidates[i] : i;
+        int j = gather ? i : g;
+        if (!s.split[j] && !s.solved[j])
+            stats.useless++;
+        else if (!s.insert(s.signatures[j]))
+            stats.duplicates++;
+        else {
+            s.kept.push_back(static_cast<uint16_t>(g));
+            s.kept_at.push_back(j);
+        }
+    }
+    int k = static_cast<int>(s.kept.size());
+    stats.kept = k;
+
+    // 4. Intern the list and build the Q table in one block. Initial Q comes from the heuristic, which needs each
+    //    kept guess's bucket sizes from the partition kernel unless it's the flat one
+    const ActionList* actions = action_pool.intern(s.kept.data(), k);
+    QTable* q_table = QTable::create(generations, k);
+
+    #pragma omp parallel if(spread && !heuristic.flat())
+    {
+        alignas(64) std::array<uint8_t, NUM_ANSWERS + 64> patterns;
+        BucketCounts buckets;
+        #pragma omp for schedule(static)
+        for (int i = 0; i < k; i++) {
+            int j = s.kept_at[i];
+            Heuristic::Sums sums{};
+            if (!heuristic.flat()) {
+                gather_patterns(lut.guess_row(s.kept[i]), s.members.data(), n, patterns.data());
+                buckets.counts.fill(0);
+                for (int a = 0; a < n; a++) buckets.counts[patterns[a]]++;
+                buckets.counts[PATTERN_SOLVED] = 0;
+                sums = heuristic.sums(buckets);
+            }
+            q_table->q()[i].store(heuristic.q(sums, n, s.solved[j]), std::memory_order_relaxed);
+            q_table->total_children()[i].store(s.children[j], std::memory_order_relaxed);
+        }
+    }
+
+    if (config.log_backups) {
+        std::lock_guard<SpinLock> guard(log_lock);
+        for (int i = 0; i < k; i++) backup_log.push_back({parent, i, q_table->q()[i].load(std::memory_order_relaxed), false});
+    }
+
+    int best = k ? 0 : -1;
+    for (int i = 1; i < k; i++)
+        if (q_table->q()[i].load(std::memory_order_relaxed) < q_table->q()[best].load(std::memory_order_relaxed)) best = i;
+
+    // 5. Finalize parent metadata. V starts at the best Q so updates have something to beat, and status goes
+    //    last so nobody reads the table before it's there
+    parent->actions = actions;
+    parent->q_table = q_table;
+    parent->num_actions = k;
+    double v = k ? q_table->q()[best].load(std::memory_order_relaxed) : 0.0;
+    if (status == NodeStatus::Evicted) stats.v_jump = v - parent->v();
+    parent->set_value(v, best);
+    parent->set_status(NodeStatus::Init);
+    arena.mark_dirty(parent, sizeof(StateNode));
+    parent->lock.unlock();
+
+    stats.ms = (omp_get_wtime() - start) * 1000.0;
+    if (config.expand_log_min && n >= config.expand_log_min)
+        printf("expand %5d answers: scanned %5d, kept %5d, gray %5d, useless %5d, duplicates %5d, %.2f ms\n",
+               n, stats.candidates, stats.kept, stats.gray, stats.useless, stats.duplicates, stats.ms);
+    return stats;
+}
+
+/**
+ * propagate_update - The update rule for this algorithm, without locks. Each level adds its child's change to the
+ *                    Q it took, then swaps V to the new best Q, and the step above gets however much V moved
+ * @param trajectory - An array of the steps taken during this episode
+ * @param trajectory_len - Length of array above
+ * @param leaf_solved - Whether the walk stopped on a solved node, which then gets counted into its parent's entry,
+ *                      and further up for as long as that solves the parent too
+ */
+void Solver::propagate_update(Step* trajectory, int trajectory_len, bool leaf_solved) {
+    Backup log[3 * MAX_DEPTH];
+    int logged = 0;
+
+    // The walk is over and went through every step, whatever the backup below stops early on
+    int first_jump = trajectory_len;
+    for (int i = 0; i < trajectory_len; i++) {
+        QTable* q_table = trajectory[i].node->q_table.get();
+        int action_ind = trajectory[i].action_ind;
+        if (config.virtual_loss > 0.0) q_table->in_flight()[action_ind].fetch_sub(1, std::memory_order_relaxed);
+        q_table->visit_count()[action_ind].fetch_add(1, std::memory_order_relaxed);
+        arena.mark_dirty(&q_table->visit_count()[action_ind], sizeof(uint32_t));
+        if (config.log_backups) log[logged++] = {trajectory[i].node, action_ind, 0.0, true};
+        if (trajectory[i].jump != 0.0 && first_jump == trajectory_len) first_jump = i;
+    }
+
+    double change = 0.0;
+    bool carrying = leaf_solved;
+    for (int i = trajectory_len - 1; i >= 0; i--) {
+        StateNode* node = trajectory[i].node;
+        int action_ind = trajectory[i].action_ind;
+        QTable* q_table = node->q_table.get();
+
+        // The child is only a weight share of this Q's expectation, so that's how much of its change carries: what
+        // the step below swapped its V by, and whatever else it moved by that this Q hasn't seen yet
+        double moved = trajectory[i].jump + (i == trajectory_len - 1 ? 0.0 : change);
+        double delta = moved * trajectory[i].weight;
+
+        if (delta != 0.0) {
+            atomic_add(q_table->q()[action_ind], delta, std::memory_order_seq_cst);
+            arena.mark_dirty(&q_table->q()[action_ind], sizeof(double));
+        }
+        if (config.log_backups && delta != 0.0) log[logged++] = {node, action_ind, delta, false};
+
+        double settled = 0.0;
+        carrying = carrying && trajectory[i].pattern != PATTERN_SOLVED && solve_child(node, trajectory[i], settled);
+        if (config.log_backups && settled != 0.0) log[logged++] = {node, action_ind, settled, false};
+
+        // Nothing moved, so nothing above sees a difference, unless a step up there has a jump of its own
+        change = 0.0;
+        if (delta == 0.0 && settled == 0.0 && !carrying) {
+            if (first_jump >= i) break;
+            continue;
+        }
+
+        double before, after;
+        bool updated = update_v(node, action_ind, before, after);
+        change = after - before;
+
+        if (carrying) node->set_status(NodeStatus::Solved); // Every entry's Q is settled from its solved children, so V is exact
+        if (updated || carrying) arena.mark_dirty(node, sizeof(StateNode));
+        if (!updated && !carrying && first_jump >= i) break;
+    }
+
+    if (logged) {
+        std::lock_guard<SpinLock> guard(log_lock);
+        backup_log.insert(backup_log.end(), log, log + logged);
+    }
+}
+
+/**
+ * arrive - A walk got to a step's child. The first one through the entry to it syncs it into the entry, and catches
+ *          the entry's Q up from what it assumed for the child to the child's V now
+ * @param step - Step the walk took to get here
+ * @param child - Where it got to, expanded already unless the walk stops on it
+ *
+ * V is read before the bit goes in. Every walk through the entry after that backs up its own change to the child,
+ * so none of those can be in this V as well
+ */
+void Solver::arrive(Step& step, StateNode* child) {
+    double v = child->v();
+    const QTable* q_table = step.node->q_table.get();
+    int children = q_table->total_children()[step.action_ind].load(std::memory_order_relaxed);
+    SolvedBuckets* record = q_table->record(step.action_ind);
+    step.first = record->sync(step.pattern, children);
+    if (step.first) arena.mark_dirty(record, SolvedBuckets::bytes(children));
+    reached(step, v);
+}
+
+/**
+ * solve_child - Counts a step's child as solved in the entry it was reached through
+ * @param node - Node the step was taken from
+ * @param step - Its child has to be solved already
+ * @param settled - How much settle_entry() moved the entry's Q, if this finished it
+ * @returns Whether that solved node: this call finished the entry and every other entry was done already
+ */
+bool Solver::solve_child(StateNode* node, const Step& step, double& settled) {
+    // Only the thread that sets the bit counts it
+    QTable* q_table = node->q_table.get();
+    int children = q_table->total_children()[step.action_ind].load(std::memory_order_relaxed);
+    SolvedBuckets* record = q_table->record(step.action_ind);
+    if (!record->mark(step.pattern, children)) return false;
+    int now = q_table->solved_children()[step.action_ind].fetch_add(1, std::memory_order_relaxed) + 1;
+    arena.mark_dirty(record, SolvedBuckets::bytes(children));
+    arena.mark_dirty(&q_table->solved_children()[step.action_ind], sizeof(uint8_t));
+    if (now < children) return false;
+
+    // That entry is done. Scanning the rest only happens once per entry, so it's cheap even at the root
+    settled = settle_entry(node, step.action_ind);
+    for (int a = 0; a < node->num_actions; a++)
+        if (!q_table->solved(a)) return false;
+    return true;
+}
+
+/**
+ * settle_entry - Sets a Q entry whose children are all solved to 1 plus their V weighted by bucket size
+ * @returns How much that moved it
+ *
+ * The backup only brings an entry the moves that came up through it. A child that other nodes reach too can
+ * move in between, so the entry lags it. Once the children are solved they don't move any more, and the entry
+ * gets the exact value. A solved node's V is the best of those
+ */
+double Solver::settle_entry(StateNode* node, int action_ind) {
+    Partition& partition = thread_partition();
+    StateKey key = node->key();
+    partition_state(wordle.get_lut(), key, node->actions->guesses()[action_ind], partition);
+
+    double q = 1.0;
+    for (int b = 0; b < partition.num_buckets; b++) {
+        uint8_t p = partition.patterns[b];
+        if (p != PATTERN_SOLVED) q += (double)partition.counts[p] / key.size() * get_or_create_node(partition.child(p))->v();
+    }
+
+    std::atomic<double>& entry = node->q_table->q()[action_ind];
+    double was = entry.exchange(q);
+    arena.mark_dirty(&entry, sizeof(double));
+    return q - was;
+}
+
+/**
+ * update_v - Brings a node's V and best action in line with its Q values after one of them moved, with one CAS
+ * @param action_ind - The entry that moved. If it's the best one, V follows it wherever it went, up means a rescan
+ * @param before - V the swap replaced, or the current one if nothing changed
+ * @param after - V it put in
+ * @returns Whether V or the best action changed
+ *
+ * Q adds and this CAS are sequentially consistent, so of two threads moving different entries at least one sees
+ * the other: either the adder's check sees the new V and rescans, its best action isn't out yet or is the entry
+ * it moved, or the swapper's recheck sees the new Q. So V never ends up stuck on a stale Q
+ */
+bool Solver::update_v(StateNode* node, int action_ind, double& before, double& after) {
+    QTable* q_table = node->q_table.get();
+    std::atomic<double>* q = q_table->q();
+    bool updated = false;
+
+    double v = node->value.load();
+    before = v;
+    after = v;
+    while (true) {
+        int best = node->best_for(v);
+        double q_now = q[action_ind].load();
+
+        int new_best;
+        if (best == action_ind || best < 0) {
+            new_best = 0;
+            for (int a = 1; a < node->num_actions; a++)
+                if (q[a].load(std::memory_order_relaxed) < q[new_best].load(std::memory_order_relaxed)) new_best = a;
+        } else if (q_now < v) {
+            new_best = action_ind;
+        } else {
+            return updated;
+        }
+
+        double next = q[new_best].load();
+        if (next == v && new_best == best) return updated;
+        if (next != v && !node->value.compare_exchange_weak(v, next)) continue;
+        node->publish_best(next, new_best);
+
+        if (!updated) before = v;
+        after = next;
+        updated = true;
+
+        // Moved again between the read and the swap, go around with it as the entry that moved
+        if (q[new_best].load() == next) return true;
+        action_ind = new_best;
+        v = next;
+    }
+}
+
+/**
+ * dp_evaluate_node - Classical dynamic programming algorithm to fully solve a node
+ * @param parent - Parent node to evaluate
+ * @returns The true expected guesses for this state with optimal play
+ */
+double Solver::dp_evaluate_node(StateNode* parent) {
+    double v = dp.evaluate(parent->key()); // Marks parent Solved, it's the node the table has for this key
+
+    // Except under DpSolver::MEMO_MIN, those have a closed form and never get recorded
+    parent->lock.lock();
+    if (parent->read_status() != NodeStatus::Solved) {
+        parent->set_value(v, -1);
+        parent->set_status(NodeStatus::Solved);
+        arena.mark_dirty(parent, sizeof(StateNode));
+    }
+    parent->lock.unlock();
+    return v;
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include "Wordle.hpp"
+#include "MemoryArena.hpp"
+#include "Nodes.hpp"
+#include "TranspositionTable.hpp"
+#include "ActionPool.hpp"
+#include "DpSolver.hpp"
+#include "Generations.hpp"
+#include "Heuristic.hpp"
+#include "Partition.hpp"
+#include "Rng.hpp"
+
+#include <vector>
+
+// Fit of optimal V against log2 of the answers left, over DP solved states of 3 to 80 answers (bench heuristic)
+constexpr double CURVE_A = 1.52;
+constexpr double CURVE_B = 0.159;
+
+struct SolverConfig {
+    int dp_threshold = 20;          // Amount of remaining possible answers to trigger full DP
+    int dp_parallel_min = 40;       // DP states at least this big get split into OpenMP tasks, 0 never splits
+    double heuristic_temp = 0.1;    // Temperature for heuristic softmax
+    HeuristicKind heuristic = HeuristicKind::Fitted; // Initial Q of newly expanded actions
+    double curve_a = CURVE_A;       // Fitted expected guesses for c answers is curve_a + curve_b * log2(c)
+    double curve_b = CURVE_B;
+    int table_size_exp = 24;        // Transposition table gets 2^this slots
+    int action_pool_size_exp = 20;  // Same for the interned action lists
+    uint64_t seed = 1;              // Each worker thread's RNG stream is derived from this and its thread number
+    int expand_parallel_min = 256;  // Expansions of states at least this big spread the guess scan over OpenMP threads
+    int expand_log_min = 0;         // Print a line for every expansion of a state at least this big, 0 never does
+    bool inherit_actions = true;    // Expand children from their parent's pruned list instead of every guess
+    bool target_unsolved = true;    // Episodes pick their answer from child buckets that aren't solved yet, by size
+    double virtual_loss = 0.1;      // Extra Q selection sees per episode in flight through an entry, 0 turns it off
+    bool log_backups = false;       // Keep every Q update for checking against a serial replay, bench backup
+    uint64_t memory_budget_mb = 0;  // Bounded memory when nonzero, see Solver::reclaim
+    double high_water = 0.85;       // Share of the budget that makes over_budget() true
+    double low_water = 0.7;         // What enforce_budget() reclaims down to
+    int keep_visits = 32;           // Q tables with at least this many backups through them survive a reclaim
+    int keep_answers = 400;         // So do ones for states at least this big, which are the ones near the root
+    int rank = 0;                   // Partitioned solving: this solver owns the rank-th of ranks ranges of state hashes,
+    int ranks = 1;                  // and walks stop on bigger than DP states outside it. See Partitioned.hpp
+};
+
+// What one expand() did. Pruned guesses are everything but the kept ones: the ones never scanned because the
+// parent had already dropped them, the gray ones, and the useless ones and duplicates among what was scanned
+struct ExpandStats {
+    int answers = 0;
+    int candidates = 0;     // Guesses that got checked, all of them without a list to inherit
+    int kept = 0;
+    int gray = 0;           // Shares no letter with any answer left
+    int useless = 0;        // Left every answer in the one bucket, and it wasn't one of them
+    int duplicates = 0;     // Same pattern for every answer as an earlier guess
+    double v_jump = 0.0;    // How far starting an evicted node over moved its V
+    double ms = 0.0;
+};
+
+// One reclaim() cycle. Kept tables got copied into the newest generation, summarized ones were solved and kept
+// only their V and best action, evicted ones were unsolved and start over from the heuristic when next reached
+struct ReclaimStats {
+    int generation = 0;             // The one that got released
+    int kept = 0;
+    int summarized = 0;
+    int evicted = 0;
+    size_t copied_bytes = 0;
+    size_t released_bytes = 0;      // Whole chunks, so reclaimed is this minus copied_bytes
+    size_t occupancy_before = 0;
+    size_t occupancy_after = 0;
+    double ms = 0.0;
+};
+
+// One compact() pass. Records are the compact nodes it wrote, freed is the full nodes, Q tables and SolvedBuckets
+// it gave back, released the whole chunks that left empty
+struct CompactStats {
+    int compacted = 0;
+    size_t record_bytes = 0;
+    size_t freed_bytes = 0;
+    size_t released_bytes = 0;
+    size_t occupancy_before = 0;
+    size_t occupancy_after = 0;
+    double ms = 0.0;
+};
+
+struct EpisodeStats {
+    long sum_depth = 0;
+    long iterations = 0;
+    long expansions = 0;
+    long expand_candidates = 0;
+    long actions_kept = 0;
+    long actions_pruned = 0;
+    double expand_ms = 0.0;
+    long rewalks = 0;               // Ended on a node that was already solved when the episode got there
+};
+
+// Where a solver's structures are in its arena. Hangs off arena root ARENA_ROOT, so a solver built on a restored
+// arena picks them back up instead of starting over
+struct SolverRoots {
+    uint64_t table;
+    uint64_t action_pool;
+    uint64_t root;
+};
+
+// One thing done to a Q entry, recorded with SolverConfig::log_backups. Expansions set the starting Q, which counts
+// as a delta onto zero without a visit, and every backup level adds one with a visit. Replaying them in any order
+// has to land on the same Q and visit counts the threads left
+struct Backup {
+    const StateNode* node;
+    int action;
+    double delta;
+    bool visit;
+};
+
+class Solver {
+    const Wordle& wordle;
+    MemoryArena& arena;
+    SolverConfig config;
+
+    static constexpr int ARENA_ROOT = 0;
+    SolverRoots* persisted;     // Null until this solver's structures exist in the arena
+
+    TranspositionTable<StateNode> table;
+    ActionPool action_pool;
+    Generations generations;    // Q tables and their SolvedBuckets
+    Generations node_blocks;    // Full episode nodes, never released wholesale, only freed one at a time by compact()
+    uint64_t keep_visits;       // config.keep_visits, raised whenever a full pass of reclaiming isn't enough
+    DpSolver dp;
+    Heuristic heuristic;
+    StateNode* root;
+
+    SpinLock log_lock;
+    std::vector<Backup> backup_log;
+
+    static constexpr double INITIAL_V = 6.0;
+
+public:
+    struct Step {
+        StateNode* node;
+        int action_ind;
+        double assumed;     // Child's V when the entry's Q got initialized, if the entry hadn't synced the child yet
+        double jump;        // What the child's V moved by that this Q hasn't seen, besides the backup from below
+        double weight;      // Child's share of the parent's answers
+        uint8_t pattern;    // Bucket the answer fell in, PATTERN_SOLVED if it was guessed
+        bool first;         // This walk is what synced the child into the entry
+    };
+
+    static constexpr int MAX_DEPTH = 20;
+
+    // An episode between its way down and its backup. A walk that stopped on a state for the DP can be finished
+    // by any thread, which is how the scheduler hands those off
+    struct Walk {
+        Step trajectory[MAX_DEPTH];
+        int depth = 0;
+        StateNode* leaf = nullptr;  // Still needs dp_evaluate_node when pending_dp
+        double final_value = 0.0;
+        bool leaf_solved = false;
+        bool pending_dp = false;
+        bool pending_remote = false; // leaf is another rank's, finish_remote() with what it answers
+    };
+
+private:
+
+    double dp_evaluate_node(StateNode* parent);
+    void propagate_update(Step* trajectory, int trajectory_len, bool leaf_solved);
+    void arrive(Step& step, StateNode* child);
+    static void reached(Step& step, double v) {
+        if (step.first) step.jump = v - step.assumed;
+    }
+    bool solve_child(StateNode* node, const Step& step, double& settled);
+    double settle_entry(StateNode* node, int action_ind);
+    bool update_v(StateNode* node, int action_ind, double& before, double& after);
+    uint8_t choose_pattern(StateNode* node, int action_ind, int guess, const StateKey& key, const Partition& partition, Rng& rng);
+
+    static SolverRoots* find_roots(MemoryArena& arena);
+    static Partition& thread_partition();
+    Rng& thread_rng() const;
+
+public:
+    // Reattaches to the solver already in the arena if there is one (table sizes then come from it, not config)
+    Solver(const Wordle& wordle, MemoryArena& arena, const SolverConfig& config);
+
+    // Finds the node for a state, or makes a fresh STATUS None one. Safe to call from any thread
+    StateNode* get_or_create_node(const StateKey& state);
+
+    // Builds a node's pruned action list and Q table. Episodes do this the first time they reach a node, it's
+    // public so it can be timed on its own. Does nothing to a node that's already been expanded.
+    // inherited is the action list of any node whose answers include all of this one's, usually its parent.
+    // Anything that node pruned is pruned here too, so only its survivors get scanned
+    ExpandStats expand(StateNode* parent, const ActionList* inherited = nullptr);
+
+    // Parallel split point, runs an exploration and update
+    EpisodeStats run_episode();
+
+    // run_episode() in two halves. walk() leaves the DP for finish() when the leaf has at least handoff_min answers.
+    // Entries the walk went through count as in flight until finish() backs it up. A walk can start below the
+    // root, which is how another rank's walk gets continued
+    EpisodeStats walk(Walk& walk, int handoff_min, StateNode* start = nullptr);
+    void finish(Walk& walk);
+
+    // Backs up a walk that stopped on another rank's state, with the V and status that rank answered for it
+    void finish_remote(Walk& walk, double v, bool solved);
+
+    // Which of ranks ranges a state hash falls in
+    static int owner_of(uint64_t hash, int ranks) {
+        return static_cast<int>((static_cast<unsigned __int128>(hash) * static_cast<unsigned>(ranks)) >> 64);
+    }
+    bool owns(const StateKey& key) const { return config.ranks <= 1 || owner_of(key.hash(), config.ranks) == config.rank; }
+
+    // Expands the root and keeps every ranks-th guess from rank on. The rest count as solved with a Q that never
+    // wins, so selection skips them and V is the best of this rank's share. Before any episode
+    void shard_root();
+
+    // Arena bytes in use, not counting chunks reclaim() freed for reuse
+    size_t occupancy() const { return arena.used() - generations.free_bytes() - node_blocks.free_bytes(); }
+
+    // Past the high water mark of a nonzero memory_budget_mb
+    bool over_budget() const {
+        return config.memory_budget_mb && occupancy() > config.high_water * (config.memory_budget_mb << 20);
+    }
+
+    // Releases the oldest generation of Q tables. Hot ones, ones near the root and the root's own get copied into
+    // a new generation first. The rest of the solved ones keep V, best action and action list, so the policy
+    // survives, and unsolved ones go Evicted. Nodes themselves and the DP's solved states are never freed.
+    // Workers have to be stopped. Each call is one generation
+    ReclaimStats reclaim();
+
+    // If over budget, reclaims down to the low water mark, one cycle per entry. Each pass releases every generation
+    // from before it once. Hot tables just get copied forward, so when a pass isn't enough the visit count a table
+    // needs to stay doubles for the next one, and for later calls. Workers have to be stopped
+    std::vector<ReclaimStats> enforce_budget();
+
+    // Swaps every solved node but the root for a compact record with just its V, best guess and how to recognize
+    // its state, and frees the full node and its Q table. Their storage goes back as chunks empty out. Workers have
+    // to be stopped, and nobody can be holding on to a node from before
+    CompactStats compact();
+
+    // Unlocks every node a dead worker process was holding, so the ones spinning on them get through. A node it
+    // died expanding is still None and just gets expanded again. Safe with workers running. Returns how many
+    int break_locks(uint32_t pid);
+
+    // Zeroes every entry's in flight count, for after a worker process died in the middle of walks and left their
+    // entries charged. Workers have to be stopped
+    void clear_in_flight();
+
+    // Abandons the table slots a dead worker process claimed and never published a node for, in the state table
+    // and the action pool, so walks waiting on them go on and make the node themselves. With workers running, only
+    // claims that are still unpublished after settle_ms count as dead, a live one is two stores from done. Returns
+    // how many
+    uint64_t abandon_claims(double settle_ms = 0.0);
+
+    StateNode* get_root() const { return root; }
+    const TranspositionTable<StateNode>& get_table() const { return table; }
+    const DpSolver& get_dp() const { return dp; }
+    const Heuristic& get_heuristic() const { return heuristic; }
+    const std::vector<Backup>& get_backup_log() const { return backup_log; }
+};
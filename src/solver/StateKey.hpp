@@ -0,0 +1,116 @@
+#pragma once
+#include "GameTypes.hpp"
+#include "Hash.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+// States with at most this many answers are stored as a sorted answer list instead of a bitmap.
+// 160 uint16_t is 320 bytes, the same as a StateBitmap, so past that the bitmap is the smaller one
+constexpr int COMPACT_KEY_MAX = 160;
+
+// Non owning view of a state in either form. Nodes store whichever form their size calls for, but a view
+// can be either, so hashing and equality don't care which form they're handed
+class StateKey {
+    const uint16_t* list;
+    const StateBitmap* bitmap;
+    int count;
+
+    StateKey(const uint16_t* list, const StateBitmap* bitmap, int count) : list(list), bitmap(bitmap), count(count) {}
+
+    // Both forms fold the same (word index, word) sequence, skipping empty words
+    static uint64_t fold(uint64_t h, int w, uint64_t bits, uint64_t step) {
+        return mix64(h ^ (bits + step * static_cast<uint64_t>(w + 1)));
+    }
+
+    uint64_t fold_all(uint64_t h, uint64_t step) const {
+        if (bitmap) {
+            for (int w = 0; w < StateBitmap::NUM_WORDS; w++) {
+                if (uint64_t bits = bitmap->word(w)) h = fold(h, w, bits, step);
+            }
+            return h;
+        }
+
+        int w = -1;
+        uint64_t bits = 0;
+        for (int i = 0; i < count; i++) {
+            int a = list[i];
+            if ((a >> 6) != w) {
+                if (bits) h = fold(h, w, bits, step);
+                w = a >> 6;
+                bits = 0;
+            }
+            bits |= 1ULL << (a & 63);
+        }
+        if (bits) h = fold(h, w, bits, step);
+        return h;
+    }
+
+public:
+    // answers has to be sorted ascending
+    static StateKey from_list(const uint16_t* answers, int count) { return StateKey(answers, nullptr, count); }
+    static StateKey from_bitmap(const StateBitmap& state, int count) { return StateKey(nullptr, &state, count); }
+    static StateKey from_bitmap(const StateBitmap& state) { return StateKey(nullptr, &state, state.count()); }
+
+    int size() const { return count; }
+    bool is_list() const { return list != nullptr; }
+    const uint16_t* get_list() const { return list; }
+    const StateBitmap& get_bitmap() const { return *bitmap; }
+
+    // The form a node stores this key in
+    static bool stores_compact(int count) { return count <= COMPACT_KEY_MAX; }
+    static size_t storage_bytes(int count) { return stores_compact(count) ? count * sizeof(uint16_t) : sizeof(StateBitmap); }
+
+    template <typename F>
+    void for_each(F f) const {
+        if (list) {
+            for (int i = 0; i < count; i++) f(static_cast<int>(list[i]));
+        } else {
+            for (int a : *bitmap) f(a);
+        }
+    }
+
+    uint64_t hash() const { return fold_all(static_cast<uint64_t>(count), 0x9e3779b97f4a7c15ULL); }
+
+    // A second hash with its own seed and step, for records that tell states apart without keeping the key.
+    // Together with hash() that's 128 bits, so two states matching both is never going to happen
+    uint64_t check_hash() const { return fold_all(mix64(count ^ 0xc2b2ae3d27d4eb4fULL), 0xff51afd7ed558ccdULL); }
+
+    bool operator==(const StateKey& other) const {
+        if (count != other.count) return false;
+        if (list && other.list) return std::memcmp(list, other.list, count * sizeof(uint16_t)) == 0;
+        if (bitmap && other.bitmap) return *bitmap == *other.bitmap;
+
+        // Mixed forms. Same size, so every listed answer being in the bitmap is enough
+        const uint16_t* l = list ? list : other.list;
+        const StateBitmap& b = bitmap ? *bitmap : *other.bitmap;
+        for (int i = 0; i < count; i++)
+            if (!b.test(l[i])) return false;
+        return true;
+    }
+
+    void to_bitmap(StateBitmap& out) const {
+        if (bitmap) {
+            out = *bitmap;
+            return;
+        }
+        out.reset();
+        for (int i = 0; i < count; i++) out.set(list[i]);
+    }
+
+    // Writes the canonical form for this size to dst, which needs storage_bytes(size()) bytes
+    // (64 byte aligned when that's a bitmap)
+    void store(void* dst) const {
+        if (!stores_compact(count)) {
+            to_bitmap(*static_cast<StateBitmap*>(dst));
+            return;
+        }
+        uint16_t* out = static_cast<uint16_t*>(dst);
+        if (list) {
+            std::memcpy(out, list, count * sizeof(uint16_t));
+        } else {
+            int i = 0;
+            for (int a : *bitmap) out[i++] = static_cast<uint16_t>(a);
+        }
+    }
+};
@@ -0,0 +1,96 @@
+#include "Transport.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+sockaddr_un address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Socket path too long: " + path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+} // namespace
+
+UnixSocketTransport::UnixSocketTransport(const std::string& dir, int rank, int ranks)
+    : me(rank), count(ranks), dir(dir), outbox(ranks), buffer(MAX_BATCH + HEADER_BYTES) {
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::runtime_error(std::string("UnixSocketTransport socket: ") + strerror(errno));
+
+    // Room for a few batches from every peer at once
+    int bytes = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+
+    std::string path = path_of(rank);
+    unlink(path.c_str()); // Left over from an earlier run
+    sockaddr_un addr = address(path);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        throw std::runtime_error("UnixSocketTransport can't bind " + path + ": " + strerror(errno));
+    }
+}
+
+UnixSocketTransport::~UnixSocketTransport() {
+    close(fd);
+    unlink(path_of(me).c_str());
+}
+
+void UnixSocketTransport::send(int to, std::vector<std::byte>& batch) {
+    if (batch.size() > MAX_BATCH) throw std::runtime_error("UnixSocketTransport batch over MAX_BATCH");
+    uint32_t from = static_cast<uint32_t>(me);
+    batch.insert(batch.begin(), reinterpret_cast<const std::byte*>(&from), reinterpret_cast<const std::byte*>(&from) + HEADER_BYTES);
+    outbox[to].push_back(std::move(batch));
+    batch.clear();
+    queued++;
+    flush();
+}
+
+// Each peer's queue goes in order, and stops at the first batch it won't take
+void UnixSocketTransport::flush() {
+    for (int to = 0; to < count && queued; to++) {
+        auto& queue = outbox[to];
+        if (queue.empty()) continue;
+        sockaddr_un addr = address(path_of(to));
+        while (!queue.empty()) {
+            const std::vector<std::byte>& batch = queue.front();
+            ssize_t sent = sendto(fd, batch.data(), batch.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOENT || errno == ECONNREFUSED || errno == ENOBUFS) {
+                    counters.stalls++;
+                    break;
+                }
+                throw std::runtime_error("UnixSocketTransport send to rank " + std::to_string(to) + ": " + strerror(errno));
+            }
+            counters.batches_sent++;
+            counters.bytes_sent += batch.size() - HEADER_BYTES;
+            queue.pop_front();
+            queued--;
+        }
+    }
+}
+
+bool UnixSocketTransport::receive(int& from, std::vector<std::byte>& batch) {
+    if (queued) flush();
+    ssize_t got = recv(fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+    if (got < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+        throw std::runtime_error(std::string("UnixSocketTransport receive: ") + strerror(errno));
+    }
+    if (static_cast<size_t>(got) < HEADER_BYTES) return false;
+
+    uint32_t sender;
+    std::memcpy(&sender, buffer.data(), HEADER_BYTES);
+    from = static_cast<int>(sender);
+    batch.assign(buffer.begin() + HEADER_BYTES, buffer.begin() + got);
+    counters.batches_received++;
+    counters.bytes_received += got - HEADER_BYTES;
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Moves batches of bytes between the ranks of a partitioned solve (Partitioned.hpp). Nothing here knows what's in
+// them. Neither side ever blocks: a batch the peer can't take yet stays queued and goes out on a later call, so
+// a rank keeps walking while its messages are on the way. Batches between two ranks arrive in the order sent.
+//
+// A cluster runs this over its interconnect. UnixSocketTransport is the one for several ranks on one machine
+class Transport {
+public:
+    struct Stats {
+        uint64_t batches_sent = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t batches_received = 0;
+        uint64_t bytes_received = 0;
+        uint64_t stalls = 0;        // Sends that found the peer full, or not there yet, and had to wait
+    };
+
+    virtual ~Transport() = default;
+
+    virtual int rank() const = 0;
+    virtual int ranks() const = 0;
+
+    // Biggest batch send() takes, in bytes
+    virtual size_t max_batch() const = 0;
+
+    // Takes the batch, the caller's vector comes back empty
+    virtual void send(int to, std::vector<std::byte>& batch) = 0;
+
+    // Next batch that's arrived from anyone, false if there isn't one. Also retries whatever send() left queued
+    virtual bool receive(int& from, std::vector<std::byte>& batch) = 0;
+
+    // Nothing sent is still waiting on this side
+    virtual bool drained() const = 0;
+
+    virtual const Stats& stats() const = 0;
+};
+
+// Datagram sockets bound at <dir>/rank<N>.sock, one per rank. Datagrams keep batch boundaries and per sender
+// order, and a full receiver makes the send fail with EAGAIN instead of dropping anything. A peer that hasn't
+// bound yet just looks full, so ranks can start in any order
+class UnixSocketTransport : public Transport {
+    static constexpr size_t HEADER_BYTES = sizeof(uint32_t); // Sender's rank
+
+    int me;
+    int count;
+    int fd = -1;
+    std::string dir;
+    std::vector<std::deque<std::vector<std::byte>>> outbox; // Per peer, each batch with its header already on
+    std::vector<std::byte> buffer;
+    size_t queued = 0;
+    Stats counters;
+
+    std::string path_of(int r) const { return dir + "/rank" + std::to_string(r) + ".sock"; }
+    void flush();
+
+public:
+    static constexpr size_t MAX_BATCH = 60 << 10; // Bytes, under the default socket buffer with room to spare
+
+    UnixSocketTransport(const std::string& dir, int rank, int ranks);
+    ~UnixSocketTransport() override;
+
+    int rank() const override { return me; }
+    int ranks() const override { return count; }
+    size_t max_batch() const override { return MAX_BATCH; }
+    void send(int to, std::vector<std::byte>& batch) override;
+    bool receive(int& from, std::vector<std::byte>& batch) override;
+    bool drained() const override { return queued == 0; }
+    const Stats& stats() const override { return counters; }
+};
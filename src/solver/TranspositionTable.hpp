@@ -0,0 +1,174 @@
+#pragma once
+#include "MemoryArena.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <immintrin.h>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+// Lock free, linear probing map from a 64 bit state hash to a node in the arena.
+//
+// Each slot is {hash, node offset}, 4 slots to a cache line, so a lookup is almost always one or two lines.
+// Inserting makes the node first, then CASes the hash into an empty slot to claim it and publishes the node's
+// offset. Anyone else probing for the same hash waits on that offset instead of making a second node, so
+// every state gets exactly one node. Making it before the claim means an allocation that throws leaves the table
+// as it was, and only the store right after the CAS is between a claim and its node. A node made for a race
+// that's lost just stays in the arena unreferenced. Slots are never emptied, which is what keeps the probing simple.
+// A claim whose node never comes, because the process making it died in between, gets turned into an abandoned
+// slot instead, which probes step over like any other hash that doesn't match.
+//
+// Everything is valid when zeroed (hash 0 is empty, offset 0 is unpublished), so the table can live in the arena.
+// Its header does too, so a restored arena can reattach to the table from the header's offset.
+//
+// Node needs a bool matches(const Key&) const for the full key check after a hash hit.
+template <typename Node>
+class TranspositionTable {
+    struct alignas(16) Slot {
+        std::atomic<uint64_t> hash;
+        std::atomic<uint64_t> node;
+    };
+
+    struct Header {
+        uint64_t mask;
+        uint64_t slots;                 // Arena offset of the slot array
+        std::atomic<uint64_t> count;
+    };
+
+    MemoryArena& arena;
+    Header* header;
+    Slot* slots;
+    uint64_t mask;                      // Copied out of the header, it's on every probe
+
+    // 0 marks an empty slot and ABANDONED a dead claim, so real hashes can't use either
+    static constexpr uint64_t ABANDONED = ~0ULL;
+    static uint64_t fix_hash(uint64_t hash) { return hash && hash != ABANDONED ? hash : 1; }
+
+    // Null if the claim gets abandoned while waiting
+    Node* wait_for_node(Slot& slot) const {
+        uint64_t off;
+        while ((off = slot.node.load(std::memory_order_acquire)) == 0) {
+            if (slot.hash.load(std::memory_order_acquire) == ABANDONED) return nullptr;
+            _mm_pause(); // The claiming thread is still constructing it
+        }
+        return arena.at<Node>(off);
+    }
+
+public:
+    // Attaches to the table whose header is at existing if that's nonzero, otherwise makes a new one with 2^size_exp slots
+    TranspositionTable(MemoryArena& arena, int size_exp, uint64_t existing = 0) : arena(arena) {
+        if (existing) {
+            header = arena.at<Header>(existing);
+        } else {
+            // Arena memory comes zeroed, which is already an empty table. Touching 2^29 slots here would cost seconds
+            header = new (arena.allocate(sizeof(Header), 64)) Header{(1ULL << size_exp) - 1, 0, {0}};
+            header->slots = arena.offset_of(arena.allocate((1ULL << size_exp) * sizeof(Slot), 64));
+        }
+        slots = arena.at<Slot>(header->slots);
+        mask = header->mask;
+    }
+
+    uint64_t offset() const { return arena.offset_of(header); }
+
+    template <typename Key>
+    Node* find(uint64_t hash, const Key& key) const {
+        hash = fix_hash(hash);
+        for (uint64_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+            uint64_t slot_hash = slots[i].hash.load(std::memory_order_acquire);
+            if (slot_hash == 0) return nullptr;
+            if (slot_hash == hash) {
+                Node* node = wait_for_node(slots[i]);
+                if (node && node->matches(key)) return node;
+            }
+        }
+        return nullptr;
+    }
+
+    // make_node() gets called at most once, on reaching an empty slot, and returns a Node* in the arena. If another
+    // thread inserts the same key first, what it made goes unused
+    template <typename Key, typename MakeNode>
+    Node* find_or_insert(uint64_t hash, const Key& key, MakeNode make_node, bool* inserted = nullptr) {
+        hash = fix_hash(hash);
+        if (inserted) *inserted = false;
+        Node* made = nullptr;
+
+        for (uint64_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+            Slot& slot = slots[i];
+            uint64_t slot_hash = slot.hash.load(std::memory_order_acquire);
+
+            if (slot_hash == 0) {
+                if (!made) made = make_node(); // Can throw, nothing is claimed yet
+                if (slot.hash.compare_exchange_strong(slot_hash, hash, std::memory_order_acq_rel)) {
+                    Node* node = made;
+                    slot.node.store(arena.offset_of(node), std::memory_order_release);
+                    header->count.fetch_add(1, std::memory_order_relaxed);
+                    arena.mark_dirty(&slot, sizeof(Slot));
+                    arena.mark_dirty(&header->count, sizeof(uint64_t));
+                    if (inserted) *inserted = true;
+                    return node;
+                }
+                // Lost the race, slot_hash now has the winner's hash, fall through and check it
+            }
+
+            if (slot_hash == hash) {
+                Node* node = wait_for_node(slot);
+                if (node && node->matches(key)) return node;
+            }
+        }
+        throw std::runtime_error("TranspositionTable full");
+    }
+
+    // Every published node, in slot order. Only with inserting threads stopped, or it can miss new ones
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (uint64_t i = 0; i <= mask; i++) {
+            uint64_t off = slots[i].node.load(std::memory_order_acquire);
+            if (off) fn(arena.at<Node>(off));
+        }
+    }
+
+    // Like for_each, but fn returns the node to keep in the slot, which can be a new one for the same key.
+    // Only with every thread that might be holding a node stopped
+    template <typename Fn>
+    void rewrite(Fn fn) {
+        for (uint64_t i = 0; i <= mask; i++) {
+            uint64_t off = slots[i].node.load(std::memory_order_acquire);
+            if (!off) continue;
+            Node* replacement = fn(arena.at<Node>(off));
+            uint64_t new_off = arena.offset_of(replacement);
+            if (new_off == off) continue;
+            slots[i].node.store(new_off, std::memory_order_release);
+            arena.mark_dirty(&slots[i], sizeof(Slot));
+        }
+    }
+
+    // Slots claimed with no node published yet, by index. With inserting threads running these are mostly claims
+    // that are a store away from their node
+    std::vector<uint64_t> unpublished() const {
+        std::vector<uint64_t> claims;
+        for (uint64_t i = 0; i <= mask; i++) {
+            uint64_t hash = slots[i].hash.load(std::memory_order_acquire);
+            if (hash != 0 && hash != ABANDONED && !slots[i].node.load(std::memory_order_acquire)) claims.push_back(i);
+        }
+        return claims;
+    }
+
+    // Abandons the slots in claims that still have no node, which lets anyone waiting on them go on probing.
+    // Only for claims whose inserter is gone: one that's alive and publishes after this leaves its node in an
+    // abandoned slot, and the state gets a second node. Returns how many
+    uint64_t abandon(const std::vector<uint64_t>& claims) {
+        uint64_t abandoned = 0;
+        for (uint64_t i : claims) {
+            uint64_t hash = slots[i].hash.load(std::memory_order_acquire);
+            if (hash == 0 || hash == ABANDONED || slots[i].node.load(std::memory_order_acquire)) continue;
+            if (!slots[i].hash.compare_exchange_strong(hash, ABANDONED, std::memory_order_acq_rel)) continue;
+            arena.mark_dirty(&slots[i], sizeof(Slot));
+            abandoned++;
+        }
+        return abandoned;
+    }
+
+    uint64_t size() const { return header->count.load(std::memory_order_relaxed); }
+    uint64_t capacity() const { return mask + 1; }
+};